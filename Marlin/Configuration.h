@@ -66,13 +66,44 @@
 // For debug-echo: 128 bytes for the optimal speed.
 // Other output doesn't need to be that speedy.
 // :[0, 2, 4, 8, 16, 32, 64, 128, 256]
-#define TX_BUFFER_SIZE 0
+#define TX_BUFFER_SIZE 128
+
+// What to do when writing to a full transmit buffer (requires TX_BUFFER_SIZE > 0)
+//   TX_OVERFLOW_BLOCK     - wait for space
+//   TX_OVERFLOW_DROP_LOGS - drop the rest of an informational log line ("log: ..."),
+//                           wait for space for everything else, i.e. protocol responses,
+//                           errors, warnings and notices are never dropped
+//                           Note: command output sent as logs (e.g. M503, D2) can
+//                                 be truncated too, so hosts must not rely on it
+// Note: dropped and stalled bytes are counted, see D2
+#define TX_OVERFLOW_POLICY TX_OVERFLOW_BLOCK
+
+// Protocol responses (e.g. "ok" and "Resend") are buffered separately, and sent
+// ahead of queued informational log lines ("log: ...") as soon as the line being
+// sent ends, so acks do not wait behind diagnostics. Responses keep their order,
+// and wait for other output (errors, warnings, notices, etc.) written earlier.
+// Longer responses are sent in parts. The responses sent early are counted, see D7.
+// Note: command output sent as log lines (e.g. D7, M503) can arrive after the
+//       command's ok, so responses are only sent early with the windowed
+//       protocol (M130 W1), legacy hosts treat the ok as the end of the output
+// Set to 0 to disable (requires TX_BUFFER_SIZE > 0).
+// :[0, 8, 16, 32, 64]
+#define TX_PRIORITY_BUFFER_SIZE 32
+
+// Send log lines (log, notice, warning and error) as compact binary records.
+// Strings are sent as their address in flash and numbers are sent in binary,
+// so a record is a fraction of the size of the text. Use decode_compact_log.py,
+// and the firmware's elf file, to convert the output back to text.
+// Note: protocol responses (e.g. ok, Resend) are always sent as text
+//#define COMPACT_LOGGING
 
 // Host Receive Buffer Size
-// Without XON/XOFF flow control (see SERIAL_XON_XOFF below) 32 bytes should be enough.
+// Holds the bytes received while a command is processed (e.g. lines in flight with the
+// windowed protocol, see M130), so the host can send up to RX_BUFFER_SIZE - 1 bytes
+// without waiting. Sizes above 256 use 16-bit indices, which are slower to update.
 // To use flow control, set this buffer size to at least 1024 bytes.
 // :[0, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048]
-#define RX_BUFFER_SIZE 128
+#define RX_BUFFER_SIZE 256
 
 #if RX_BUFFER_SIZE >= 1024
   // Enable to have the controller send XON/XOFF control characters to
@@ -80,23 +111,40 @@
   //#define SERIAL_XON_XOFF
 #endif
 
-// Enable this option to collect and display the maximum
-// RX queue usage after transferring a file to SD.
-//#define SERIAL_STATS_MAX_RX_QUEUED
+// Count receive errors -- bytes dropped because the receive buffer was full,
+// hardware overruns (a byte arrived before the previous one was read, i.e.
+// interrupts were disabled for too long) and framing errors (e.g. a baud rate
+// mismatch or noise) -- and track the receive buffer's high-water mark.
+// Reported by D2, and logged when they change.
+//#define SERIAL_STATS_RX
 
-// Enable this option to collect and display the number
-// of dropped bytes after a file transfer to SD.
-//#define SERIAL_STATS_DROPPED_RX
-
-// Enable an emergency-command parser to intercept certain commands as they
-// enter the serial receive buffer, so they cannot be blocked.
-// Currently handles M108, M112, M410
-// Does not work on boards using AT90USB (USBCON) processors!
-//#define EMERGENCY_PARSER
+// Realtime commands -- single bytes (feed hold, resume, abort and status) that are
+// acted on as they are received, so they are not blocked by queued commands
+// (see src/work/realtime_commands.cpp)
+//#define REALTIME_COMMANDS
 
 // Buffers for command processing
+//   MAX_CMD_SIZE        - the longest command, in bytes
+//   BUFSIZE             - the most commands that can be queued
+//   COMMAND_BUFFER_SIZE - bytes for queued commands, each uses its length plus 5
+//                         bytes (7 with PROTOCOL_STATS), e.g. 384 bytes holds about
+//                         ten 25 byte commands (room for a MAX_CMD_SIZE command is
+//                         always kept free)
 #define MAX_CMD_SIZE 96
-#define BUFSIZE 4
+#define BUFSIZE 16
+#define COMMAND_BUFFER_SIZE 384
+
+// Count commands, resends and the time from receiving a command to sending its
+// ok, to measure the command protocol (see D7 and src/work/windowed_host.py)
+//#define PROTOCOL_STATS
+
+// Binary commands -- compact moves, framed with COBS and checked with a CRC16,
+// they coexist with text commands (see src/commands/binaryCommand.h)
+//#define BINARY_COMMANDS
+
+// Binary telemetry -- step counts, bed temperature and planner state, sent as
+// COBS frames at the rate set with M131 (see src/work/telemetry.cpp)
+//#define BINARY_TELEMETRY
 
 
 //===========================================================================
@@ -236,6 +284,18 @@ micro/step * 200 step / 16 teeth  * 24 teeth / 1 rev * 1 rev / 0.7 mm pitch
 
 #define MAX_STEP_FREQUENCY 40000 // Max step frequency for Ultimaker (5000 pps / half step)
 
+// Babystepping -- live adjustment of Z (e.g. bead height while dispensing)
+// The stepper isr issues babysteps independently of the queued moves
+// Note: 1 step every 1000us (1kHz) is 0.625mm/s, which is below the Z jerk speed
+#define BABYSTEP_MAX_Z_OFFSET 0.5 // (mm) limit on the total adjustment, in either direction
+#define BABYSTEP_INTERVAL 2000    // (2MHz timer tics) minimum time between babysteps
+#define BABYSTEP_REALTIME_STEPS 1 // (steps) adjustment per realtime babystep byte (see realtime_commands.cpp)
+
+// Stepper event trace -- records the timing of each stepper isr call, output with D6
+// Note: uses 4 bytes of RAM per event
+//#define STEPPER_TRACE
+#define STEPPER_TRACE_SIZE 256 // (events) must be a power of 2
+
 //By default pololu step drivers require an active high signal. However, some high power drivers require an active low signal as step.
 #define INVERT_X_STEP_PIN false
 #define INVERT_Y_STEP_PIN false
@@ -260,6 +320,36 @@ micro/step * 200 step / 16 teeth  * 24 teeth / 1 rev * 1 rev / 0.7 mm pitch
 // Motor Current setting (Only functional when motor driver current ref pins are connected to a digital trimpot on supported boards)
 #define DIGIPOT_MOTOR_CURRENT {50,180,60,60} // Values 0-255 (x, y, z, e)
 
+//===========================================================================
+//=============================Bed Temperature Control=======================
+//===========================================================================
+
+// PID control of the bed heater, with time-proportional output (i.e. the heater is on
+// for part of each period). When disabled, the heater is switched on/off (bang-bang)
+// every 500ms, and ramps (M140 R, profiles) move the point it switches at. Gains are
+// tuned with M303, set with M304 and stored with M500.
+// Note: the default gains are from a simulation, run M303 once enabled
+//#define PIDTEMPBED
+#define BED_PID_PERIOD_MS 1000 // (ms) control period, and the heater's switching window
+
+// Default gains, output (0-255) per C, per C*s and per C/s
+// Note: from M303 on a simulated bed (see src/vone/bed/heater/simulate_heater.py), run
+//       M303 on the printer for better values
+#define DEFAULT_bedKp 40.0
+#define DEFAULT_bedKi 4.0
+#define DEFAULT_bedKd 100.0
+
+// Bed model, used as feedforward, i.e. dT/dt = A * output - B * (T - BED_AMBIENT_TEMP), with
+// A the heating rate at full output (C/s) and B the loss coefficient (1/s). With a model,
+// the output follows ramps closely, and heating ramps at BED_MODEL_RATE_MARGIN of the
+// rate the heater can sustain, so the bed does not overshoot. Identified with M306, set
+// A to 0 to disable (i.e. PID only).
+#define DEFAULT_bedModelA 0.0
+#define DEFAULT_bedModelB 0.0
+#define BED_AMBIENT_TEMP 25.0     // (C)
+#define BED_MODEL_RATE_MARGIN 0.8
+#define BED_RAMP_SETTLE_TIME 10.0 // (s) ramps slow down over their last ~10s, the thermistor lags the bed
+
 
 //===========================================================================
 //=============================Additional Features===========================
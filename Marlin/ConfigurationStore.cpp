@@ -43,7 +43,9 @@ void _EEPROM_readData(int &pos, uint8_t* value, uint8_t size) {
 
 #define SETTINGS_VERSION_NONE "000"
 #define SETTINGS_VERSION_V12 "V12"
-#define CURRENT_SETTINGS_VERSION SETTINGS_VERSION_V12
+#define SETTINGS_VERSION_V13 "V13"
+#define SETTINGS_VERSION_V14 "V14"
+#define CURRENT_SETTINGS_VERSION SETTINGS_VERSION_V14
 
 void Config_StoreCalibration() {
   // Mark the stored settings as invalid
@@ -101,6 +103,28 @@ void Config_StoreSettings() {
   EEPROM_WRITE_VAR(i, max_z_jerk);
   EEPROM_WRITE_VAR(i, max_e_jerk);
 
+  // V13
+  // Note: always written, so the layout does not depend on PIDTEMPBED
+  #if ENABLED(PIDTEMPBED)
+    EEPROM_WRITE_VAR(i, bedKp);
+    EEPROM_WRITE_VAR(i, bedKi);
+    EEPROM_WRITE_VAR(i, bedKd);
+  #else
+    float unused = 0;
+    EEPROM_WRITE_VAR(i, unused);
+    EEPROM_WRITE_VAR(i, unused);
+    EEPROM_WRITE_VAR(i, unused);
+  #endif
+
+  // V14
+  #if ENABLED(PIDTEMPBED)
+    EEPROM_WRITE_VAR(i, bedModelA);
+    EEPROM_WRITE_VAR(i, bedModelB);
+  #else
+    EEPROM_WRITE_VAR(i, unused);
+    EEPROM_WRITE_VAR(i, unused);
+  #endif
+
   // Now write the version, which marks the stored data as valid
   char ver2[4] = CURRENT_SETTINGS_VERSION;
   i = EEPROM_OFFSET;
@@ -144,6 +168,19 @@ void Config_PrintSettings() {
       << F(" Z") << max_z_jerk
       << F(" E") << max_e_jerk
       << endl;
+
+  #if ENABLED(PIDTEMPBED)
+    log << F("Bed PID gains:") << endl;
+    log << F("  M304 P") << bedKp
+        << F(" I") << bedKi
+        << F(" D") << bedKd
+        << endl;
+
+    log << F("Bed model: A=heating rate at full output (C/s), B=loss coefficient (1/s), 0 to disable") << endl;
+    log << F("  M306 A") << FloatWithFormat(bedModelA, 4)
+        << F(" B") << FloatWithFormat(bedModelB, 6)
+        << endl;
+  #endif
 }
 
 void Config_PrintCalibration() {
@@ -257,7 +294,11 @@ void Config_RetrieveSettings() {
     EEPROM_READ_VAR(i, stored_ver);
 
     // check version
-    if (strncmp(stored_ver, CURRENT_SETTINGS_VERSION, 3) == 0) {
+    // Note: V12 is V14 without the bed PID gains and model, V13 is V14
+    //       without the bed model
+    const bool isV12 = strncmp(stored_ver, SETTINGS_VERSION_V12, 3) == 0;
+    const bool isV13 = strncmp(stored_ver, SETTINGS_VERSION_V13, 3) == 0;
+    if (isV12 || isV13 || strncmp(stored_ver, CURRENT_SETTINGS_VERSION, 3) == 0) {
       log << F("Reading speed settings, version ") << stored_ver << endl;
 
       EEPROM_READ_VAR(i, axis_steps_per_unit);
@@ -276,6 +317,40 @@ void Config_RetrieveSettings() {
       EEPROM_READ_VAR(i, max_z_jerk);
       EEPROM_READ_VAR(i, max_e_jerk);
 
+      #if ENABLED(PIDTEMPBED)
+        if (isV12) {
+          bedKp = DEFAULT_bedKp;
+          bedKi = DEFAULT_bedKi;
+          bedKd = DEFAULT_bedKd;
+        } else {
+          EEPROM_READ_VAR(i, bedKp);
+          EEPROM_READ_VAR(i, bedKi);
+          EEPROM_READ_VAR(i, bedKd);
+        }
+
+        if (isV12 || isV13) {
+          bedModelA = DEFAULT_bedModelA;
+          bedModelB = DEFAULT_bedModelB;
+        } else {
+          EEPROM_READ_VAR(i, bedModelA);
+          EEPROM_READ_VAR(i, bedModelB);
+        }
+
+        // Note: M304 and M306 reject negative values, so these are not
+        //       stored values (e.g. the EEPROM was not written by them)
+        if (!(bedKp >= 0 && bedKi >= 0 && bedKd >= 0)) {
+          logWarning << F("Stored bed PID gains are invalid, using defaults") << endl;
+          bedKp = DEFAULT_bedKp;
+          bedKi = DEFAULT_bedKi;
+          bedKd = DEFAULT_bedKd;
+        }
+        if (!(bedModelA >= 0 && bedModelB >= 0)) {
+          logWarning << F("Stored bed model is invalid, using defaults") << endl;
+          bedModelA = DEFAULT_bedModelA;
+          bedModelB = DEFAULT_bedModelB;
+        }
+      #endif
+
       logNotice << F("Using stored values for speed settings") << endl;
     } else {
       const auto isOldConfig = strncmp(stored_ver, SETTINGS_VERSION_NONE, 3) != 0;
@@ -309,5 +384,13 @@ void Config_UseDefaultSettings() {
   max_z_jerk = DEFAULT_ZJERK;
   max_e_jerk = DEFAULT_EJERK;
 
+  #if ENABLED(PIDTEMPBED)
+    bedKp = DEFAULT_bedKp;
+    bedKi = DEFAULT_bedKi;
+    bedKd = DEFAULT_bedKd;
+    bedModelA = DEFAULT_bedModelA;
+    bedModelB = DEFAULT_bedModelB;
+  #endif
+
   log << F("Using hardcoded defaults for speed settings") << endl;
 }
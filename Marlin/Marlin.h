@@ -30,6 +30,10 @@ extern float xypos_x_pos;
 extern float xypos_y_pos;
 extern float xypos_z_pos;
 extern int z_switch_type;
+#if ENABLED(PIDTEMPBED)
+  extern float bedKp, bedKi, bedKd; // see Heater
+  extern float bedModelA, bedModelB;
+#endif
 
 
 void setStepperInactiveDuration(unsigned long duration);
@@ -49,6 +49,38 @@ ring_buffer_r rx_buffer = { { 0 }, 0, 0 };
 #if TX_BUFFER_SIZE > 0
   ring_buffer_t tx_buffer = { { 0 }, 0, 0 };
   static bool _written;
+  static uint32_t tx_dropped_bytes = 0;
+  static uint32_t tx_stalled_bytes = 0;
+
+  #if TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+    bool tx_line_droppable = false;
+    static bool tx_line_dropping = false; // dropping the rest of the current line
+  #endif
+#endif
+
+#if TX_PRIORITY_BUFFER_SIZE > 0
+  struct ring_buffer_p {
+    unsigned char buffer[TX_PRIORITY_BUFFER_SIZE];
+    volatile uint8_t head, tail;
+  };
+  static ring_buffer_p tx_priority_buffer = { { 0 }, 0, 0 };
+  bool tx_line_priority = false;
+  static uint8_t tx_priority_pending = 0; // end of the line being written, see publishPriority
+  static bool tx_priority_sending = false; // in the middle of sending a response
+
+  // Responses only overtake informational log lines, other output (e.g. errors,
+  // warnings and command output) is sent first, so it stays ahead of the ok
+  bool tx_line_overtakable = false; // the line being written is a log line
+  static volatile bool tx_ordered_pending = false; // output that must not be overtaken is queued
+  static volatile uint8_t tx_ordered_end = 0; // where it ends in the output buffer
+
+  // Where the other output is, i.e. if a response can be sent now
+  // Note: compact log records and telemetry are delimited by zeros
+  enum TxLineState : uint8_t { TX_AT_LINE_END, TX_IN_LINE, TX_IN_FRAME };
+  static uint8_t tx_line_state = TX_AT_LINE_END;
+
+  static uint32_t tx_preempted = 0;
+  static uint32_t tx_preempted_bytes = 0;
 #endif
 
 #if ENABLED(SERIAL_XON_XOFF)
@@ -60,106 +92,17 @@ ring_buffer_r rx_buffer = { { 0 }, 0, 0 };
   uint8_t xon_xoff_state = XON_XOFF_CHAR_SENT | XON_CHAR;
 #endif
 
-#if ENABLED(SERIAL_STATS_DROPPED_RX)
-  uint8_t rx_dropped_bytes = 0;
+#if ENABLED(SERIAL_STATS_RX)
+  static uint32_t rx_dropped_bytes = 0;
+  static uint32_t rx_overruns = 0;
+  static uint32_t rx_framing_errors = 0;
+  static ring_buffer_pos_t rx_high_water = 0;
 #endif
 
-#if ENABLED(SERIAL_STATS_MAX_RX_QUEUED)
-  ring_buffer_pos_t rx_max_enqueued = 0;
+#if ENABLED(REALTIME_COMMANDS)
+  #include "src/work/work.h"
 #endif
 
-#if ENABLED(EMERGENCY_PARSER)
-
-  #include "stepper.h"
-  #include "language.h"
-
-  // Currently looking for: M108, M112, M410
-  // If you alter the parser please don't forget to update the capabilities in Conditionals_post.h
-
-  FORCE_INLINE void emergency_parser(const unsigned char c) {
-
-    static e_parser_state state = state_RESET;
-
-    switch (state) {
-      case state_RESET:
-        switch (c) {
-          case ' ': break;
-          case 'N': state = state_N;      break;
-          case 'M': state = state_M;      break;
-          default: state = state_IGNORE;
-        }
-        break;
-
-      case state_N:
-        switch (c) {
-          case '0': case '1': case '2':
-          case '3': case '4': case '5':
-          case '6': case '7': case '8':
-          case '9': case '-': case ' ':   break;
-          case 'M': state = state_M;      break;
-          default:  state = state_IGNORE;
-        }
-        break;
-
-      case state_M:
-        switch (c) {
-          case ' ': break;
-          case '1': state = state_M1;     break;
-          case '4': state = state_M4;     break;
-          default: state = state_IGNORE;
-        }
-        break;
-
-      case state_M1:
-        switch (c) {
-          case '0': state = state_M10;    break;
-          case '1': state = state_M11;    break;
-          default: state = state_IGNORE;
-        }
-        break;
-
-      case state_M10:
-        state = (c == '8') ? state_M108 : state_IGNORE;
-        break;
-
-      case state_M11:
-        state = (c == '2') ? state_M112 : state_IGNORE;
-        break;
-
-      case state_M4:
-        state = (c == '1') ? state_M41 : state_IGNORE;
-        break;
-
-      case state_M41:
-        state = (c == '0') ? state_M410 : state_IGNORE;
-        break;
-
-      case state_IGNORE:
-        if (c == '\n') state = state_RESET;
-        break;
-
-      default:
-        if (c == '\n') {
-          switch (state) {
-            case state_M108:
-              wait_for_user = wait_for_heatup = false;
-              break;
-            case state_M112:
-              kill(PSTR(MSG_KILLED));
-              break;
-            case state_M410:
-              quickstop_stepper();
-              break;
-            default:
-              break;
-          }
-          state = state_RESET;
-        }
-    }
-  }
-
-#endif // EMERGENCY_PARSER
-
 FORCE_INLINE void store_rxd_char() {
   const ring_buffer_pos_t h = rx_buffer.head,
                           i = (ring_buffer_pos_t)(h + 1) & (ring_buffer_pos_t)(RX_BUFFER_SIZE - 1);
@@ -167,22 +110,41 @@ FORCE_INLINE void store_rxd_char() {
   // If the character is to be stored at the index just before the tail
   // (such that the head would advance to the current tail), the buffer is
   // critical, so don't write the character or advance the head.
+  #if ENABLED(SERIAL_STATS_RX)
+    // Note: the error flags describe the byte in the data register,
+    //       so they must be read before it
+    const uint8_t status = M_UCSRxA;
+    if (TEST(status, M_DORx)) {
+      ++rx_overruns;
+    }
+    if (TEST(status, M_FEx)) {
+      ++rx_framing_errors;
+    }
+  #endif
   const char c = M_UDRx;
+
+  #if ENABLED(REALTIME_COMMANDS)
+    // Realtime commands are acted on now, and not stored
+    if (receiveRealtimeCommand(c)) {
+      return;
+    }
+  #endif
+
   if (i != rx_buffer.tail) {
     rx_buffer.buffer[h] = c;
     rx_buffer.head = i;
   }
   else {
-    #if ENABLED(SERIAL_STATS_DROPPED_RX)
-      if (!++rx_dropped_bytes) ++rx_dropped_bytes;
+    #if ENABLED(SERIAL_STATS_RX)
+      ++rx_dropped_bytes;
     #endif
   }
 
-  #if ENABLED(SERIAL_STATS_MAX_RX_QUEUED)
+  #if ENABLED(SERIAL_STATS_RX)
     // calculate count of bytes stored into the RX buffer
     ring_buffer_pos_t rx_count = (ring_buffer_pos_t)(rx_buffer.head - rx_buffer.tail) & (ring_buffer_pos_t)(RX_BUFFER_SIZE - 1);
     // Keep track of the maximum count of enqueued bytes
-    NOLESS(rx_max_enqueued, rx_count);
+    NOLESS(rx_high_water, rx_count);
   #endif
 
   #if ENABLED(SERIAL_XON_XOFF)
@@ -232,17 +194,48 @@ FORCE_INLINE void store_rxd_char() {
       }
     }
   #endif // SERIAL_XON_XOFF
-
-  #if ENABLED(EMERGENCY_PARSER)
-    emergency_parser(c);
-  #endif
 }
 
 #if TX_BUFFER_SIZE > 0
 
+  #if TX_PRIORITY_BUFFER_SIZE > 0
+    enum TxLane : uint8_t { TX_LANE_NONE, TX_LANE_OUTPUT, TX_LANE_PRIORITY };
+
+    // Protocol responses go ahead of other output, but only at the end of a
+    // line (or frame), so lines are never mixed
+    FORCE_INLINE TxLane _tx_next_lane() {
+      const bool output = tx_buffer.head != tx_buffer.tail;
+      const bool priority = tx_priority_buffer.head != tx_priority_buffer.tail;
+      if (tx_priority_sending) {
+        // Finish the response, it is sent in parts if it is longer than the
+        // buffer. While waiting for the next part, only send other output if
+        // the buffer is full (i.e. an interrupt handler is waiting for room)
+        if (priority) {
+          return TX_LANE_PRIORITY;
+        }
+        const bool outputFull = ((tx_buffer.head + 1) & (TX_BUFFER_SIZE - 1)) == tx_buffer.tail;
+        return outputFull ? TX_LANE_OUTPUT : TX_LANE_NONE;
+      }
+      if (priority && !tx_ordered_pending && (!output || tx_line_state == TX_AT_LINE_END)) {
+        return TX_LANE_PRIORITY;
+      }
+      return output ? TX_LANE_OUTPUT : TX_LANE_NONE;
+    }
+
+    FORCE_INLINE void _tx_update_line_state(const uint8_t c) {
+      if (tx_line_state == TX_IN_FRAME) {
+        tx_line_state = c == 0 ? TX_AT_LINE_END : TX_IN_FRAME;
+      } else if (c == 0) {
+        tx_line_state = TX_IN_FRAME;
+      } else {
+        tx_line_state = c == '\n' ? TX_AT_LINE_END : TX_IN_LINE;
+      }
+    }
+  #endif
+
   FORCE_INLINE void _tx_udr_empty_irq(void) {
     // If interrupts are enabled, there must be more data in the output
-    // buffer.
+    // buffer (unless waiting for the rest of a protocol response).
 
     #if ENABLED(SERIAL_XON_XOFF)
       // Do a priority insertion of an XON/XOFF char, if needed.
@@ -253,11 +246,34 @@ FORCE_INLINE void store_rxd_char() {
       }
       else
     #endif
-    { // Send the next byte
-      const uint8_t t = tx_buffer.tail, c = tx_buffer.buffer[t];
-      tx_buffer.tail = (t + 1) & (TX_BUFFER_SIZE - 1);
-      M_UDRx = c;
-    }
+    #if TX_PRIORITY_BUFFER_SIZE > 0
+      {
+        const TxLane lane = _tx_next_lane();
+        if (lane == TX_LANE_PRIORITY) {
+          const uint8_t t = tx_priority_buffer.tail, c = tx_priority_buffer.buffer[t];
+          tx_priority_buffer.tail = (t + 1) & (TX_PRIORITY_BUFFER_SIZE - 1);
+          tx_priority_sending = c != '\n';
+          M_UDRx = c;
+        } else if (lane == TX_LANE_OUTPUT) {
+          const uint8_t t = tx_buffer.tail, c = tx_buffer.buffer[t];
+          tx_buffer.tail = (t + 1) & (TX_BUFFER_SIZE - 1);
+          if (tx_buffer.tail == tx_ordered_end) {
+            tx_ordered_pending = false;
+          }
+          _tx_update_line_state(c);
+          M_UDRx = c;
+        } else {
+          CBI(M_UCSRxB, M_UDRIEx);
+          return;
+        }
+      }
+    #else
+      { // Send the next byte
+        const uint8_t t = tx_buffer.tail, c = tx_buffer.buffer[t];
+        tx_buffer.tail = (t + 1) & (TX_BUFFER_SIZE - 1);
+        M_UDRx = c;
+      }
+    #endif
 
     // clear the TXC bit -- "can be cleared by writing a one to its bit
     // location". This makes sure flush() won't return until the bytes
@@ -265,8 +281,12 @@ FORCE_INLINE void store_rxd_char() {
     SBI(M_UCSRxA, M_TXCx);
 
     // Disable interrupts if the buffer is empty
-    if (tx_buffer.head == tx_buffer.tail)
-      CBI(M_UCSRxB, M_UDRIEx);
+    #if TX_PRIORITY_BUFFER_SIZE > 0
+      if (_tx_next_lane() == TX_LANE_NONE)
+    #else
+      if (tx_buffer.head == tx_buffer.tail)
+    #endif
+        CBI(M_UCSRxB, M_UDRIEx);
   }
 
   #ifdef M_USARTx_UDRE_vect
@@ -365,6 +385,36 @@ int MarlinSerial::read(void) {
   return v;
 }
 
+#if ENABLED(SERIAL_STATS_RX)
+  uint32_t MarlinSerial::rxDropped() {
+    CRITICAL_SECTION_START;
+      const uint32_t v = rx_dropped_bytes;
+    CRITICAL_SECTION_END;
+    return v;
+  }
+
+  uint32_t MarlinSerial::rxOverruns() {
+    CRITICAL_SECTION_START;
+      const uint32_t v = rx_overruns;
+    CRITICAL_SECTION_END;
+    return v;
+  }
+
+  uint32_t MarlinSerial::rxFramingErrors() {
+    CRITICAL_SECTION_START;
+      const uint32_t v = rx_framing_errors;
+    CRITICAL_SECTION_END;
+    return v;
+  }
+
+  ring_buffer_pos_t MarlinSerial::rxHighWater() {
+    CRITICAL_SECTION_START;
+      const ring_buffer_pos_t v = rx_high_water;
+    CRITICAL_SECTION_END;
+    return v;
+  }
+#endif
+
 ring_buffer_pos_t MarlinSerial::available(void) {
   CRITICAL_SECTION_START;
     const ring_buffer_pos_t h = rx_buffer.head, t = rx_buffer.tail;
@@ -389,14 +439,129 @@ void MarlinSerial::flush(void) {
 }
 
 #if TX_BUFFER_SIZE > 0
+  // Returns the number of bytes that can be written without waiting
+  // Note: the ring holds at most TX_BUFFER_SIZE - 1 bytes
   uint8_t MarlinSerial::availableForWrite(void) {
     CRITICAL_SECTION_START;
       const uint8_t h = tx_buffer.head, t = tx_buffer.tail;
     CRITICAL_SECTION_END;
-    return (uint8_t)(TX_BUFFER_SIZE + h - t) & (TX_BUFFER_SIZE - 1);
+    return (uint8_t)(TX_BUFFER_SIZE - 1) - ((uint8_t)(TX_BUFFER_SIZE + h - t) & (TX_BUFFER_SIZE - 1));
   }
 
+  uint32_t MarlinSerial::txDropped() {
+    CRITICAL_SECTION_START;
+      const uint32_t v = tx_dropped_bytes;
+    CRITICAL_SECTION_END;
+    return v;
+  }
+
+  uint32_t MarlinSerial::txStalled() {
+    CRITICAL_SECTION_START;
+      const uint32_t v = tx_stalled_bytes;
+    CRITICAL_SECTION_END;
+    return v;
+  }
+
+  #if TX_PRIORITY_BUFFER_SIZE > 0
+    void MarlinSerial::beginPriorityLine() {
+      if (tx_line_priority) {
+        return;
+      }
+      tx_line_priority = true;
+
+      // Count the output this response will (likely) go ahead of, i.e. the
+      // log lines queued after any output it must wait for
+      CRITICAL_SECTION_START;
+        const uint8_t start = tx_ordered_pending ? tx_ordered_end : tx_buffer.tail;
+        const uint8_t queued = (uint8_t)(TX_BUFFER_SIZE + tx_buffer.head - start) & (TX_BUFFER_SIZE - 1);
+        if (queued) {
+          ++tx_preempted;
+          tx_preempted_bytes += queued;
+        }
+      CRITICAL_SECTION_END;
+    }
+
+    uint32_t MarlinSerial::txPreempted() {
+      CRITICAL_SECTION_START;
+        const uint32_t v = tx_preempted;
+      CRITICAL_SECTION_END;
+      return v;
+    }
+
+    uint32_t MarlinSerial::txPreemptedBytes() {
+      CRITICAL_SECTION_START;
+        const uint32_t v = tx_preempted_bytes;
+      CRITICAL_SECTION_END;
+      return v;
+    }
+
+    // Let the interrupt handler send the response written so far
+    static void publishPriority() {
+      CRITICAL_SECTION_START;
+        tx_priority_buffer.head = tx_priority_pending;
+        SBI(M_UCSRxB, M_UDRIEx);
+      CRITICAL_SECTION_END;
+    }
+
+    // Responses are published when complete, so the interrupt handler
+    // does not wait for the rest of a response while there is other
+    // output to send, unless the response is longer than the buffer
+    static void writePriority(const uint8_t c) {
+      _written = true;
+      const uint8_t i = (tx_priority_pending + 1) & (TX_PRIORITY_BUFFER_SIZE - 1);
+      if (i == tx_priority_buffer.tail) {
+        ++tx_stalled_bytes;
+        publishPriority();
+      }
+      while (i == tx_priority_buffer.tail) {
+        if (!TEST(SREG, SREG_I) && TEST(M_UCSRxA, M_UDREx)) {
+          // Interrupts are disabled, see writeNoHandshake
+          _tx_udr_empty_irq();
+        }
+      }
+
+      tx_priority_buffer.buffer[tx_priority_pending] = c;
+      tx_priority_pending = i;
+      if (c == '\n') {
+        tx_line_priority = false;
+        publishPriority();
+      }
+    }
+  #endif
+
+  #if TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+    bool MarlinSerial::dropLine(uint8_t size) {
+      // Lines longer than the buffer are dropped only if the buffer is full
+      const uint8_t needed = size < TX_BUFFER_SIZE - 1 ? size : TX_BUFFER_SIZE - 1;
+      const bool drop = tx_line_droppable && availableForWrite() < needed;
+      tx_line_droppable = false;
+      tx_line_dropping = false;
+      if (drop) {
+        tx_dropped_bytes += size;
+      }
+      return drop;
+    }
+  #endif
+
   void MarlinSerial::write(const uint8_t c) {
+    #if TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+      // Once we start dropping a line, drop the rest of it, but always
+      // write the newline, so the next line starts cleanly
+      if (tx_line_droppable && c != '\n') {
+        if (!tx_line_dropping && availableForWrite() == 0) {
+          tx_line_dropping = true;
+        }
+        if (tx_line_dropping) {
+          ++tx_dropped_bytes;
+          return;
+        }
+      }
+      if (c == '\n') {
+        tx_line_droppable = false;
+        tx_line_dropping = false;
+      }
+    #endif
+
     #if ENABLED(SERIAL_XON_XOFF)
       const uint8_t state = xon_xoff_state;
       if (!(state & XON_XOFF_CHAR_SENT)) {
@@ -405,13 +570,30 @@ void MarlinSerial::flush(void) {
         xon_xoff_state = state | XON_XOFF_CHAR_SENT;
       }
     #endif
+    #if TX_PRIORITY_BUFFER_SIZE > 0
+      if (tx_line_priority) {
+        writePriority(c);
+        return;
+      }
+    #endif
     writeNoHandshake(c);
+
+    #if TX_PRIORITY_BUFFER_SIZE > 0
+      // Note: frames (i.e. compact log records) are never overtaken, their
+      //       start (a zero) ends the line
+      if (c == '\n' || c == 0) {
+        tx_line_overtakable = false;
+      }
+    #endif
   }
 
   void MarlinSerial::writeNoHandshake(const uint8_t c) {
     _written = true;
     CRITICAL_SECTION_START;
       bool emty = (tx_buffer.head == tx_buffer.tail);
+      #if TX_PRIORITY_BUFFER_SIZE > 0
+        emty = emty && !tx_priority_sending && tx_priority_buffer.head == tx_priority_buffer.tail;
+      #endif
     CRITICAL_SECTION_END;
 
     // If the buffer and the data register is empty, just write the byte
@@ -420,6 +602,9 @@ void MarlinSerial::flush(void) {
     // 500kbit/s) bitrates, where interrupt overhead becomes a slowdown.
     if (emty && TEST(M_UCSRxA, M_UDREx)) {
       CRITICAL_SECTION_START;
+        #if TX_PRIORITY_BUFFER_SIZE > 0
+          _tx_update_line_state(c);
+        #endif
         M_UDRx = c;
         SBI(M_UCSRxA, M_TXCx);
       CRITICAL_SECTION_END;
@@ -429,6 +614,9 @@ void MarlinSerial::flush(void) {
 
     // If the output buffer is full, there's nothing for it other than to
     // wait for the interrupt handler to empty it a bit
+    if (i == tx_buffer.tail) {
+      ++tx_stalled_bytes;
+    }
     while (i == tx_buffer.tail) {
       if (!TEST(SREG, SREG_I)) {
         // Interrupts are disabled, so we'll have to poll the data
@@ -446,6 +634,12 @@ void MarlinSerial::flush(void) {
     tx_buffer.buffer[tx_buffer.head] = c;
     { CRITICAL_SECTION_START;
         tx_buffer.head = i;
+        #if TX_PRIORITY_BUFFER_SIZE > 0
+          if (!tx_line_overtakable) {
+            tx_ordered_pending = true;
+            tx_ordered_end = i;
+          }
+        #endif
         SBI(M_UCSRxB, M_UDRIEx);
       CRITICAL_SECTION_END;
     }
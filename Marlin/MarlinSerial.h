@@ -59,6 +59,8 @@
 #define M_UBRRxH           SERIAL_REGNAME(UBRR,SERIAL_PORT,H)
 #define M_UBRRxL           SERIAL_REGNAME(UBRR,SERIAL_PORT,L)
 #define M_RXCx             SERIAL_REGNAME(RXC,SERIAL_PORT,)
+#define M_DORx             SERIAL_REGNAME(DOR,SERIAL_PORT,)
+#define M_FEx              SERIAL_REGNAME(FE,SERIAL_PORT,)
 #define M_USARTx_RX_vect   SERIAL_REGNAME(USART,SERIAL_PORT,_RX_vect)
 #define M_U2Xx             SERIAL_REGNAME(U2X,SERIAL_PORT,)
 #define M_USARTx_UDRE_vect SERIAL_REGNAME(USART,SERIAL_PORT,_UDRE_vect)
@@ -80,6 +82,18 @@
   #define TX_BUFFER_SIZE 32
 #endif
 
+// Transmit buffer overflow policies (see Configuration.h)
+#define TX_OVERFLOW_BLOCK     0
+#define TX_OVERFLOW_DROP_LOGS 1
+#ifndef TX_OVERFLOW_POLICY
+  #define TX_OVERFLOW_POLICY TX_OVERFLOW_BLOCK
+#endif
+
+// Transmit buffer for protocol responses (see Configuration.h)
+#ifndef TX_PRIORITY_BUFFER_SIZE
+  #define TX_PRIORITY_BUFFER_SIZE 0
+#endif
+
 #ifndef USBCON
   #if ENABLED(SERIAL_XON_XOFF) && RX_BUFFER_SIZE < 1024
     #error "SERIAL_XON_XOFF requires RX_BUFFER_SIZE >= 1024 for reliable transfers without drops."
@@ -93,18 +107,22 @@
     #error "TX_BUFFER_SIZE must be 0, a power of 2 greater than 1, and no greater than 256."
   #endif
 
+  #if TX_PRIORITY_BUFFER_SIZE && (TX_BUFFER_SIZE == 0 || TX_PRIORITY_BUFFER_SIZE < 8 || TX_PRIORITY_BUFFER_SIZE > 256 || !IS_POWER_OF_2(TX_PRIORITY_BUFFER_SIZE))
+    #error "TX_PRIORITY_BUFFER_SIZE must be 0, or a power of 2 from 8 to 256 (and requires TX_BUFFER_SIZE > 0)."
+  #endif
+
   #if RX_BUFFER_SIZE > 256
     typedef uint16_t ring_buffer_pos_t;
   #else
     typedef uint8_t ring_buffer_pos_t;
   #endif
 
-  #if ENABLED(SERIAL_STATS_DROPPED_RX)
-    extern uint8_t rx_dropped_bytes;
+  #if TX_BUFFER_SIZE > 0 && TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+    extern bool tx_line_droppable;
   #endif
-
-  #if ENABLED(SERIAL_STATS_MAX_RX_QUEUED)
-    extern ring_buffer_pos_t rx_max_enqueued;
+  #if TX_PRIORITY_BUFFER_SIZE > 0
+    extern bool tx_line_priority;
+    extern bool tx_line_overtakable;
   #endif
 
   class MarlinSerial { //: public Stream
@@ -122,15 +140,86 @@
       #if TX_BUFFER_SIZE > 0
         static uint8_t availableForWrite(void);
         static void flushTX(void);
+
+        // Bytes dropped, or that had to wait, because the transmit buffer was full
+        static uint32_t txDropped();
+        static uint32_t txStalled();
       #endif
       static void writeNoHandshake(const uint8_t c);
 
-      #if ENABLED(SERIAL_STATS_DROPPED_RX)
-        FORCE_INLINE static uint32_t dropped() { return rx_dropped_bytes; }
+      // Mark the line being written as informational, so it can be dropped if the
+      // transmit buffer is full (see TX_OVERFLOW_POLICY), or as a protocol response,
+      // so it is sent ahead of queued output (see TX_PRIORITY_BUFFER_SIZE). Reset at
+      // the end of the line.
+      // Note: interrupt handlers should save and restore the state (see
+      //       saveLineState), so their output does not inherit it
+      FORCE_INLINE static uint8_t saveLineState() {
+        uint8_t s = 0;
+        #if TX_BUFFER_SIZE > 0 && TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+          if (tx_line_droppable) { s |= 0x01; }
+          tx_line_droppable = false;
+        #endif
+        #if TX_PRIORITY_BUFFER_SIZE > 0
+          if (tx_line_priority) { s |= 0x02; }
+          if (tx_line_overtakable) { s |= 0x04; }
+          tx_line_priority = false;
+          tx_line_overtakable = false;
+        #endif
+        return s;
+      }
+      FORCE_INLINE static void restoreLineState(uint8_t s) {
+        #if TX_BUFFER_SIZE > 0 && TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+          tx_line_droppable = s & 0x01;
+        #endif
+        #if TX_PRIORITY_BUFFER_SIZE > 0
+          tx_line_priority = s & 0x02;
+          tx_line_overtakable = s & 0x04;
+        #endif
+        UNUSED(s);
+      }
+
+      #if TX_PRIORITY_BUFFER_SIZE > 0
+        static void beginPriorityLine();
+
+        // Protocol responses sent ahead of queued output, and the queued bytes
+        // they went ahead of (at most, the rest of the line being sent is not
+        // overtaken)
+        static uint32_t txPreempted();
+        static uint32_t txPreemptedBytes();
+      #else
+        FORCE_INLINE static void beginPriorityLine() {}
+      #endif
+
+      // Note: informational log lines are also the only output protocol
+      //       responses can overtake (see TX_PRIORITY_BUFFER_SIZE)
+      #if TX_BUFFER_SIZE > 0 && TX_OVERFLOW_POLICY == TX_OVERFLOW_DROP_LOGS
+        FORCE_INLINE static void beginDroppableLine() {
+          tx_line_droppable = true;
+          #if TX_PRIORITY_BUFFER_SIZE > 0
+            tx_line_overtakable = true;
+          #endif
+        }
+
+        // For lines that are written all at once (i.e. compact log records), returns
+        // true if the line is droppable and size bytes do not fit in the transmit
+        // buffer, in which case the caller should not write it. Ends the line.
+        static bool dropLine(uint8_t size);
+      #else
+        FORCE_INLINE static void beginDroppableLine() {
+          #if TX_PRIORITY_BUFFER_SIZE > 0
+            tx_line_overtakable = true;
+          #endif
+        }
+        FORCE_INLINE static bool dropLine(uint8_t) { return false; }
       #endif
 
-      #if ENABLED(SERIAL_STATS_MAX_RX_QUEUED)
-        FORCE_INLINE static ring_buffer_pos_t rxMaxEnqueued() { return rx_max_enqueued; }
+      #if ENABLED(SERIAL_STATS_RX)
+        // Bytes dropped because the receive buffer was full, hardware overruns
+        // and framing errors, and the most bytes held in the receive buffer
+        static uint32_t rxDropped();
+        static uint32_t rxOverruns();
+        static uint32_t rxFramingErrors();
+        static ring_buffer_pos_t rxHighWater();
       #endif
 
     private:
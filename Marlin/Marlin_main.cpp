@@ -67,6 +67,13 @@ float xypos_y_pos;
 float xypos_z_pos;
 char product_serial_number[15];
 int z_switch_type = -1;
+#if ENABLED(PIDTEMPBED)
+  float bedKp = DEFAULT_bedKp;
+  float bedKi = DEFAULT_bedKi;
+  float bedKd = DEFAULT_bedKd;
+  float bedModelA = DEFAULT_bedModelA;
+  float bedModelB = DEFAULT_bedModelB;
+#endif
 
 //===========================================================================
 
@@ -147,8 +154,14 @@ void setup() {
 }
 
 void periodic_work() {
-  manage_heating_profile();
+  #if ENABLED(REALTIME_COMMANDS)
+    reportRealtimeCommands();
+  #endif
+  report_heating_profile();
   manage_inactivity();
+  #if ENABLED(BINARY_TELEMETRY)
+    output_telemetry();
+  #endif
   glow_leds();
   manufacturing_procedures(); /// <--TODO: should not be here
 }
@@ -172,6 +185,11 @@ void loop() {
   // Note: hits for synchronous commands are detected in processSerialCommands
   checkForEndstopHits();
 
+  // Finish aborts requested by realtime commands
+  #if ENABLED(REALTIME_COMMANDS)
+    processRealtimeCommands();
+  #endif
+
   reportBufferEmpty();   // not important enough to monitor
   periodic_output();     // will generate excessive output
 }
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+
+""" Decode the output of firmware built with COMPACT_LOGGING.
+
+Log lines are sent as binary records (see serial.cpp), that refer to strings
+by their address in flash. The strings are read from the firmware's elf file,
+which must be from the same build as the firmware (arduino-cli leaves it next
+to the hex file, e.g. ../build/Marlin.ino.elf).
+
+Reads a capture of the serial output, or a serial port (requires pyserial),
+and outputs the text the firmware would have sent without COMPACT_LOGGING.
+"""
+
+import argparse
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('elf', help="the firmware's elf file")
+parser.add_argument('input', help='file containing the serial output, or a serial port (with --port)')
+parser.add_argument('-p', '--port', action='store_true', help='read from a serial port, until interrupted')
+parser.add_argument('-b', '--baud', type=int, default=250000, help='baud rate (default=250000)')
+args = parser.parse_args()
+
+# Record item tags, see logging::compact::Tag
+FLASH_STRING, RAM_STRING, CHAR, INT16, UINT16, INT32, UINT32, FLOAT, TRUNCATED = range(1, 10)
+
+# Other frames, which are skipped
+TELEMETRY_FRAME = 0x80  # see src/work/decode_telemetry.py
+
+
+class Flash:
+    """ The loadable sections of an elf file, in flash (i.e. program) space """
+
+    def __init__(self, path):
+        data = open(path, 'rb').read()
+        if data[:4] != b'\x7fELF' or data[4] != 1:
+            sys.exit(path + ' is not a 32-bit elf file')
+        shoff, = struct.unpack_from('<I', data, 32)
+        shentsize, shnum = struct.unpack_from('<HH', data, 46)
+
+        self.sections = []
+        for i in range(shnum):
+            _, kind, flags, addr, offset, size = struct.unpack_from('<IIIIII', data, shoff + i * shentsize)
+            SHT_PROGBITS, SHF_ALLOC = 1, 0x2
+            # Note: avr-gcc places ram at 0x800000 in the elf's address space
+            if kind == SHT_PROGBITS and flags & SHF_ALLOC and addr < 0x800000:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, address):
+        for start, contents in self.sections:
+            if start <= address < start + len(contents):
+                end = contents.index(b'\0', address - start)
+                return contents[address - start:end].decode('ascii', 'replace')
+        return '<unknown string 0x%04x>' % address
+
+
+def crc16(data):
+    """ CRC-16/CCITT-FALSE, see utils/crc16.h """
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """ See utils/cobs.h, returns None if the data is not valid """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_record(flash, frame):
+    record = cobs_decode(frame)
+    if record is None or len(record) < 2:
+        return '<invalid log record>'
+    if record[0] == TELEMETRY_FRAME:
+        return None
+    items, crc = record[:-2], struct.unpack('<H', record[-2:])[0]
+    if crc16(items) != crc:
+        return '<corrupt log record>'
+
+    text = ''
+    i = 0
+    while i < len(items):
+        tag = items[i]
+        i += 1
+        if tag == FLASH_STRING:
+            text += flash.string(struct.unpack_from('<H', items, i)[0])
+            i += 2
+        elif tag == RAM_STRING:
+            end = items.index(b'\0', i)
+            text += items[i:end].decode('ascii', 'replace')
+            i = end + 1
+        elif tag == CHAR:
+            text += chr(items[i])
+            i += 1
+        elif tag in (INT16, UINT16, INT32, UINT32):
+            fmt = {INT16: '<h', UINT16: '<H', INT32: '<i', UINT32: '<I'}[tag]
+            text += str(struct.unpack_from(fmt, items, i)[0])
+            i += struct.calcsize(fmt)
+        elif tag == FLOAT:
+            value, digits = struct.unpack_from('<fB', items, i)
+            text += '%.*f' % (digits, value)
+            i += 5
+        elif tag == TRUNCATED:
+            text += '<truncated>'
+        else:
+            return text + '<unknown item 0x%02x>' % tag
+    return text
+
+
+def decode(flash, chunks):
+    """ Split the output into text lines and frames (delimited by zeros) """
+    pending = bytearray()
+    in_frame = False
+    for chunk in chunks:
+        for byte in chunk:
+            if byte == 0:
+                # Note: a zero after an empty frame starts a frame (i.e. resyncs)
+                if in_frame and pending:
+                    text = decode_record(flash, pending)
+                    if text is not None:
+                        print(text)
+                    in_frame = False
+                else:
+                    if pending:
+                        print(pending.decode('ascii', 'replace'), end='')
+                    in_frame = True
+                pending.clear()
+            else:
+                pending.append(byte)
+                if not in_frame and byte == ord('\n'):
+                    print(pending.decode('ascii', 'replace'), end='')
+                    pending.clear()
+        sys.stdout.flush()
+    if pending and not in_frame:
+        print(pending.decode('ascii', 'replace'), end='')
+
+
+def read_port():
+    import serial
+    port = serial.Serial(args.input, args.baud, timeout=0.1)
+    while True:
+        yield port.read(port.in_waiting or 1)
+
+
+flash = Flash(args.elf)
+try:
+    decode(flash, read_port() if args.port else [open(args.input, 'rb').read()])
+except KeyboardInterrupt:
+    pass
@@ -30,6 +30,10 @@
   #define CRITICAL_SECTION_END    SREG = _sreg;
 #endif
 
+// Prevent the compiler from moving memory accesses across this point
+// (e.g. to order writes that are shared with an interrupt handler)
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
 
 // Clock speed factor
 #define CYCLES_PER_MICROSECOND (F_CPU / 1000000UL) // 16 or 20
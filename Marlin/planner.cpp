@@ -198,16 +198,18 @@ void calculate_trapezoid_for_block(block_t *block, float entry_factor, float exi
     plateau_steps = 0;
   }
 
-  // block->accelerate_until = accelerate_steps;
-  // block->decelerate_after = accelerate_steps+plateau_steps;
-  CRITICAL_SECTION_START;  // Fill variables used by the stepper in a critical section
+  // Fill variables used by the stepper, unless the stepper isr has claimed the block
+  // Note: see the block buffer notes, in planner.h, for why this order matters
+  block->updating = true;
+  COMPILER_BARRIER();
   if(block->busy == false) { // Don't update variables if block is busy.
     block->accelerate_until = accelerate_steps;
     block->decelerate_after = accelerate_steps+plateau_steps;
     block->initial_rate = initial_rate;
     block->final_rate = final_rate;
   }
-  CRITICAL_SECTION_END;
+  COMPILER_BARRIER();
+  block->updating = false;
 }
 
 // Calculates the maximum allowable speed at this point when you must be able to reach target_velocity using the
@@ -257,10 +259,9 @@ static void planner_reverse_pass_kernel(block_t *current, block_t *next) {
 void planner_reverse_pass() {
   uint8_t block_index = block_buffer_head;
 
-  //Make a local copy of block_buffer_tail, because the interrupt can alter it
-  CRITICAL_SECTION_START;
-  unsigned char tail = block_buffer_tail;
-  CRITICAL_SECTION_END
+  // Make a local copy of block_buffer_tail, because the interrupt can alter it
+  // Note: it's a single byte, so no need to disable interrupts to read it
+  const unsigned char tail = block_buffer_tail;
 
   if(((block_buffer_head-tail + BLOCK_BUFFER_SIZE) & (BLOCK_BUFFER_SIZE - 1)) > 3) {
     block_index = (block_buffer_head - 3) & (BLOCK_BUFFER_SIZE - 1);
@@ -473,6 +474,7 @@ void plan_buffer_line(float x, float y, float z, float e, float feed_rate)
 
   // Mark block as not busy (Not executed by the stepper interrupt)
   block->busy = false;
+  block->updating = false;
 
   block->steps_x = labs(steps_x_signed);
   block->steps_y = labs(steps_y_signed);
@@ -689,7 +691,9 @@ void plan_buffer_line(float x, float y, float z, float e, float feed_rate)
   calculate_trapezoid_for_block(block, block->entry_speed/block->nominal_speed,
   safe_speed/block->nominal_speed);
 
-  // Move buffer head
+  // Move buffer head (i.e. publish the block to the stepper isr)
+  // Note: the block must be completely written first
+  COMPILER_BARRIER();
   block_buffer_head = next_buffer_head;
 
   // Update position
@@ -56,7 +56,8 @@ typedef struct {
   unsigned long initial_rate;                        // The jerk-adjusted step rate at start of block
   unsigned long final_rate;                          // The minimal rate at exit
   unsigned long acceleration_st;                     // acceleration steps/sec^2
-  volatile bool busy;
+  volatile bool busy;                                // Claimed by the stepper isr
+  volatile bool updating;                            // The planner is writing the trapezoid settings
 } block_t;
 
 // Initialize the motion plan subsystem
@@ -96,6 +97,20 @@ extern float calib_tan_theta;
 extern float calib_x_backlash;
 extern float calib_y_backlash;
 
+// The block buffer is a single-producer (the planner) single-consumer (the
+// stepper isr) queue. Interrupts are not masked to access it:
+//   - The planner owns block_buffer_head and the stepper isr owns block_buffer_tail.
+//     Both are single bytes, so they are read and written atomically.
+//   - The planner fills a block completely before publishing it, by advancing
+//     block_buffer_head.
+//   - The planner may rewrite the trapezoid settings of published blocks, until the
+//     stepper isr claims the block (by setting busy). To do this it sets updating,
+//     then checks busy, writes the settings, and finally clears updating. The isr will
+//     not claim a block that is being updated (see plan_claim_current_block), so it
+//     never sees a partial update.
+//   - The stepper isr discards blocks by advancing block_buffer_tail.
+// Note: the planner cannot interrupt the stepper isr, which is why the updating/busy
+//       handshake is sufficient (see planner_handoff_test.cpp, in src/work/protocol_harness).
 extern block_t block_buffer[BLOCK_BUFFER_SIZE];            // A ring buffer for motion instfructions
 extern volatile unsigned char block_buffer_head;           // Index of the next block to be pushed
 extern volatile unsigned char block_buffer_tail;
@@ -116,6 +131,17 @@ FORCE_INLINE block_t* plan_get_current_block() {
   return block;
 }
 
+// Claims the current block for the stepper isr. Returns NULL if the buffer is empty,
+// or if the planner is updating the block (in which case, try again shortly)
+FORCE_INLINE block_t* plan_claim_current_block() {
+  block_t *block = plan_get_current_block();
+  if (!block || block->updating) {
+    return nullptr;
+  }
+  block->busy = true;
+  return block;
+}
+
 // Gets the current block. Returns NULL if buffer empty
 FORCE_INLINE bool blocks_queued() {
   return block_buffer_head != block_buffer_tail;
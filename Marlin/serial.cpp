@@ -6,4 +6,138 @@ const char endl[] = "\n";
 namespace logging {
   bool inISR = false;
   LogSuppesser suppressLog;
+  bool tagErrors = false;
+  uint16_t errorLineNumber = 0;
+  bool priorityResponses = false;
 }
+
+#if ENABLED(COMPACT_LOGGING)
+
+#include <string.h>
+
+#include "src/utils/cobs.h"
+#include "src/utils/crc16.h"
+#include "src/vone/VOne.h"
+
+// Compact log records
+// Each log line is sent as a frame: 0x00, the COBS encoded record, 0x00.
+// The record is a list of items, each a tag byte followed by its value
+// (little-endian), then a CRC16 of the items (see decode_compact_log.py).
+// Strings in flash are sent as their address, which the host looks up in the
+// firmware's elf file.
+// Note: strings (and tags) never contain zeros once encoded, so frames can be
+//       picked out of the text responses (which never contain zeros either)
+// Note: interrupt handlers record their lines too, they save the line being
+//       recorded by the main loop (see save), and the temperature isr (the
+//       only one that logs) is held off while a frame is sent, so a frame is
+//       never split by another
+namespace logging {
+  namespace compact {
+    enum Tag : uint8_t {
+      FlashString = 0x01, // uint16 address
+      RamString   = 0x02, // characters, then a zero
+      Char        = 0x03, // char
+      Int16       = 0x04, // int16
+      UInt16      = 0x05, // uint16
+      Int32       = 0x06, // int32
+      UInt32      = 0x07, // uint32
+      Float       = 0x08, // float, then the number of digits to output
+      Truncated   = 0x09  // the rest of the line did not fit in the record
+    };
+
+    bool active = false;
+    static bool s_truncated = false;
+    static uint8_t s_size = 0;
+    static uint8_t s_record[MaxRecordSize + 3]; // room for the truncated tag and crc
+
+    static void s_send() {
+      if (s_truncated) {
+        s_record[s_size++] = Truncated;
+      }
+      const uint16_t crc = crc16(s_record, s_size);
+      s_record[s_size++] = crc & 0xFF;
+      s_record[s_size++] = crc >> 8;
+
+      if (MYSERIAL.dropLine(cobsMaxEncodedSize(s_size) + 2)) {
+        return;
+      }
+      const bool temperatureIsrWasEnabled = TEMPERATURE_ISR_ENABLED();
+      DISABLE_TEMPERATURE_INTERRUPT();
+      MYSERIAL.write(uint8_t(0));
+      cobsEncode(s_record, s_size, [](uint8_t byte) { MYSERIAL.write(byte); });
+      MYSERIAL.write(uint8_t(0));
+      if (temperatureIsrWasEnabled) {
+        ENABLE_TEMPERATURE_INTERRUPT();
+      }
+    }
+
+    static void s_append(Tag tag, const void* value, uint8_t size) {
+      if (s_truncated || s_size + 1 + size > MaxRecordSize) {
+        s_truncated = true;
+        return;
+      }
+      s_record[s_size++] = tag;
+      memcpy(&s_record[s_size], value, size);
+      s_size += size;
+    }
+
+    void begin() {
+      // Send the previous line, if it was not ended
+      if (active) {
+        s_send();
+      }
+      active = true;
+      s_truncated = false;
+      s_size = 0;
+    }
+
+    void write(const __FlashStringHelper* str) {
+      // Skip empty strings (e.g. isrPrefix)
+      if (pgm_read_byte(str) == 0) {
+        return;
+      }
+      const uint16_t address = reinterpret_cast<uintptr_t>(str);
+      s_append(FlashString, &address, sizeof(address));
+    }
+
+    void write(const char* str) {
+      if (str == endl) {
+        active = false;
+        s_send();
+        return;
+      }
+      s_append(RamString, str, strlen(str) + 1);
+    }
+
+    void write(char ch) { s_append(Char, &ch, sizeof(ch)); }
+    void write(int value) { s_append(Int16, &value, sizeof(value)); }
+    void write(unsigned int value) { s_append(UInt16, &value, sizeof(value)); }
+    void write(long value) { s_append(Int32, &value, sizeof(value)); }
+    void write(unsigned long value) { s_append(UInt32, &value, sizeof(value)); }
+
+    void write(float value, uint8_t digits) {
+      uint8_t item[sizeof(value) + 1];
+      memcpy(item, &value, sizeof(value));
+      item[sizeof(value)] = digits;
+      s_append(Float, item, sizeof(item));
+    }
+
+    // Note: a line the interrupt handler did not end is discarded on restore
+    void save(SavedRecord& saved) {
+      saved.active = active;
+      saved.truncated = s_truncated;
+      saved.size = s_size;
+      memcpy(saved.items, s_record, s_size);
+      active = false;
+    }
+
+    void restore(const SavedRecord& saved) {
+      active = saved.active;
+      s_truncated = saved.truncated;
+      s_size = saved.size;
+      memcpy(s_record, saved.items, s_size);
+    }
+  }
+}
+
+#endif
@@ -18,6 +18,16 @@ namespace logging {
   extern bool inISR;
   extern LogSuppesser suppressLog;
 
+  // The line number of the command being processed, included in errors so the
+  // host can match them to lines (windowed protocol only, see
+  // process_serial_commands.cpp)
+  extern bool tagErrors;
+  extern uint16_t errorLineNumber;
+
+  // Whether protocol responses may be sent ahead of log lines (windowed
+  // protocol only, see TX_PRIORITY_BUFFER_SIZE)
+  extern bool priorityResponses;
+
   inline const __FlashStringHelper* isrPrefix() {
     if (inISR) {
       return F("~~~");
@@ -35,19 +45,60 @@ namespace logging {
   inline static const __FlashStringHelper* errorName() { return F("\"name\": \""); }
   inline static const __FlashStringHelper* errorContext() { return F("\"context\": \""); }
   inline static const __FlashStringHelper* errorReason() { return F("\"reason\": \""); }
+
+  // Compact logging, log lines are buffered as binary records and sent
+  // when the line ends (see serial.cpp)
+  namespace compact {
+  #if ENABLED(COMPACT_LOGGING)
+    static const uint8_t MaxRecordSize = 64;
+
+    // The line being recorded, saved by interrupt handlers so they can record
+    // their own lines without disturbing it (see VOne.cpp)
+    struct SavedRecord {
+      bool active;
+      bool truncated;
+      uint8_t size;
+      uint8_t items[MaxRecordSize + 3]; // the record can be interrupted while it is ended
+    };
+
+    extern bool active;
+    void begin();
+    void write(const __FlashStringHelper* str);
+    void write(const char* str); // ends the record, if str is endl
+    void write(char ch);
+    void write(int value);
+    void write(unsigned int value);
+    void write(long value);
+    void write(unsigned long value);
+    void write(float value, uint8_t digits);
+
+    void save(SavedRecord& saved);
+    void restore(const SavedRecord& saved);
+
+    inline bool recording() { return active; }
+  #else
+    inline void begin() {}
+  #endif
+  }
 }
 
-inline MarlinSerial& operator<<(MarlinSerial &obj, unsigned long arg) { obj.print(arg); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj, unsigned  int arg) { obj.print(arg); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj,          long arg) { obj.print(arg); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj,           int arg) { obj.print(arg); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj,         float arg) { obj.print(arg, 6); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj,        double arg) { obj.print(arg, 6); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj,          char arg) { obj.print(arg); return obj; }
-inline MarlinSerial& operator<<(MarlinSerial &obj,   const char* arg) { obj.print(arg); return obj; }
+#if ENABLED(COMPACT_LOGGING)
+  #define WRITE_COMPACT(...) if (logging::compact::recording()) { logging::compact::write(__VA_ARGS__); return obj; }
+#else
+  #define WRITE_COMPACT(...)
+#endif
+
+inline MarlinSerial& operator<<(MarlinSerial &obj, unsigned long arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj, unsigned  int arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj,          long arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj,           int arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj,         float arg) { WRITE_COMPACT(arg, 6) obj.print(arg, 6); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj,        double arg) { WRITE_COMPACT(float(arg), 6) obj.print(arg, 6); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj,          char arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj,   const char* arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
 
 class __FlashStringHelper;
-inline MarlinSerial& operator<<(MarlinSerial &obj, const __FlashStringHelper* arg) { obj.print(arg); return obj; }
+inline MarlinSerial& operator<<(MarlinSerial &obj, const __FlashStringHelper* arg) { WRITE_COMPACT(arg) obj.print(arg); return obj; }
 
 
 template<typename T>
@@ -73,17 +124,26 @@ struct FloatWithFormat {
   FloatWithFormat(float v, unsigned int d) : value(v), digits(d) {}
 };
 inline MarlinSerial& operator<<(MarlinSerial &obj, const FloatWithFormat& st) {
+  WRITE_COMPACT(st.value, st.digits)
   obj.print(st.value, st.digits);
   return obj;
 }
 
 
+// Note: protocol responses are sent ahead of queued log output (see TX_PRIORITY_BUFFER_SIZE),
+//       except from interrupt handlers, which could interrupt another response
 inline MarlinSerial& protocol() {
+  if (logging::priorityResponses && !logging::inISR) {
+    MYSERIAL.beginPriorityLine();
+  }
   return MYSERIAL << logging::isrPrefix();
 }
 #define protocol protocol()
 
+// Note: informational logs can be dropped if the transmit buffer is full (see TX_OVERFLOW_POLICY)
 inline MarlinSerial& log() {
+  MYSERIAL.beginDroppableLine();
+  logging::compact::begin();
   return MYSERIAL << logging::isrPrefix() << F("log: ");
 }
 #define log log()
@@ -95,17 +155,24 @@ inline MarlinSerial& logDebug() {
 
 
 inline MarlinSerial& logNotice() {
+  logging::compact::begin();
   return MYSERIAL << logging::isrPrefix() << F("notice: ");
 }
 #define logNotice logNotice()
 
 inline MarlinSerial& logWarning() {
+  logging::compact::begin();
   return MYSERIAL << logging::isrPrefix() << F("warning: ");
 }
 #define logWarning logWarning()
 
 inline MarlinSerial& logError() {
-  return MYSERIAL << logging::isrPrefix() << F("error: ");
+  logging::compact::begin();
+  MYSERIAL << logging::isrPrefix() << F("error: ");
+  if (logging::tagErrors && !logging::inISR) {
+    MYSERIAL << F("N") << logging::errorLineNumber << F(" ");
+  }
+  return MYSERIAL;
 }
 #define logError logError()
 
@@ -30,5 +30,9 @@ bool isOverBed(float x, float y);
 bool haveBedHeightMap();
 float bedHeightAt(float x, float y);
 
+// Bed heater (requires PIDTEMPBED)
+int autotuneBedHeater(float target, int cycles);
+int identifyBedHeaterModel(float target, int coolingSeconds);
+
 // LEDs
 int overrideLeds(char r, char b, char g, short pace = 3); // 3 = fast pulse
@@ -0,0 +1,139 @@
+#include "../api/api.h"
+#include "../../Marlin.h"
+#include "../../ConfigurationStore.h"
+#include "../vone/VOne.h"
+#include "../utils/time.h"
+
+#if ENABLED(PIDTEMPBED)
+
+// Relay autotune (as in Marlin's M303)
+// Drives the heater high/low around the target, so the bed oscillates,
+// and derives gains from the oscillation's amplitude and period, i.e. the
+// ultimate gain and period (Ziegler-Nichols). The relay's bias is adjusted
+// each cycle so the time spent above and below the target is even.
+//
+// Notes:
+//   1) The relay does not switch back within 5s of a switch, so noise
+//      around the target does not make it chatter
+//   2) Uses the heater's output directly, the heater still shuts off
+//      if the temperature is out of range
+static const auto MaxOutput = PidController::MaxOutput;
+static const unsigned long MinSwitchTime = 5000;
+static const float MaxOvershoot = 20.0f;
+
+static int s_fail(const __FlashStringHelper* reason) {
+  logError << F("Unable to autotune bed heater, ") << reason << endl;
+  vone->heater.setManualOutput(-1);
+  vone->heater.setTargetTemperature(0);
+  return -1;
+}
+
+int autotuneBedHeater(float target, int cycles) {
+  if (target < 40 || target > 240) {
+    logError << F("Unable to autotune bed heater, target must be between 40 and 240C") << endl;
+    return -1;
+  }
+  if (cycles < 3 || cycles > 20) {
+    logError << F("Unable to autotune bed heater, cycles must be between 3 and 20") << endl;
+    return -1;
+  }
+
+  log << F("Autotuning bed heater at ") << target << F("C, cycles: ") << cycles << endl;
+
+  // The target is only used for reporting (e.g. M105)
+  Heater& heater = vone->heater;
+  heater.setTargetTemperature(target);
+
+  int16_t bias = MaxOutput / 2;
+  int16_t amplitude = MaxOutput / 2;
+  heater.setManualOutput(bias + amplitude);
+
+  bool heating = true;
+  auto highStart = millis();
+  auto lowStart = highStart;
+  unsigned long highTime = 0;
+  unsigned long lowTime = 0;
+  float maxTemp = 0;
+  float minTemp = 10000;
+  float kp = 0, ki = 0, kd = 0;
+  auto cycleDeadline = highStart + minutes(20);
+  auto nextSampleAt = highStart;
+
+  for (int cycle = 0; cycle <= cycles; ) {
+    periodic_work();
+
+    const auto now = millis();
+    if (now < nextSampleAt) {
+      continue;
+    }
+    nextSampleAt = now + BED_PID_PERIOD_MS;
+
+    const auto current = heater.currentTemperature();
+    NOLESS(maxTemp, current);
+    NOMORE(minTemp, current);
+
+    if (current > target + MaxOvershoot) {
+      return s_fail(F("temperature is too high"));
+    }
+    if (now > cycleDeadline) {
+      return s_fail(F("timed out waiting for the temperature to cross the target"));
+    }
+
+    if (heating && current > target && now - highStart > MinSwitchTime) {
+      // Switch low
+      heating = false;
+      heater.setManualOutput(bias - amplitude);
+      lowStart = now;
+      highTime = lowStart - highStart;
+      maxTemp = target;
+      cycleDeadline = now + minutes(20);
+
+    } else if (!heating && current < target && now - lowStart > MinSwitchTime) {
+      // Switch high, completing a cycle
+      heating = true;
+      highStart = now;
+      lowTime = highStart - lowStart;
+      cycleDeadline = now + minutes(20);
+
+      if (cycle > 0) {
+        // Even out the time spent high and low
+        bias += (amplitude * ((long)highTime - (long)lowTime)) / (long)(lowTime + highTime);
+        bias = constrain(bias, 20, MaxOutput - 20);
+        amplitude = bias > MaxOutput / 2 ? MaxOutput - 1 - bias : bias;
+
+        const float ku = (4.0f * amplitude) / (M_PI * (maxTemp - minTemp) / 2.0f);
+        const float tu = (lowTime + highTime) / 1000.0f;
+        kp = 0.6f * ku;
+        ki = 2.0f * kp / tu;
+        kd = kp * tu / 8.0f;
+        log
+          << F("Autotune cycle ") << cycle
+          << F(": bias:") << bias
+          << F(" amplitude:") << amplitude
+          << F(" min:") << minTemp
+          << F(" max:") << maxTemp
+          << F(" Ku:") << ku
+          << F(" Tu:") << tu
+          << endl;
+      }
+      heater.setManualOutput(bias + amplitude);
+      minTemp = target;
+      ++cycle;
+    }
+  }
+
+  heater.setManualOutput(-1);
+  heater.setTargetTemperature(0);
+
+  bedKp = kp;
+  bedKi = ki;
+  bedKd = kd;
+  heater.updateSettings();
+  Config_StoreSettings();
+
+  log << F("Autotune complete, gains:") << endl;
+  log << F("  M304 P") << bedKp << F(" I") << bedKi << F(" D") << bedKd << endl;
+  return 0;
+}
+
+#endif
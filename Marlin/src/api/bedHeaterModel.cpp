@@ -0,0 +1,147 @@
+#include "../api/api.h"
+#include "../../Marlin.h"
+#include "../../ConfigurationStore.h"
+#include "../vone/VOne.h"
+#include "../utils/time.h"
+
+#if ENABLED(PIDTEMPBED)
+
+// Bed model identification
+// Heats at full output to the target, then cools with the heater off, and
+// fits the model (see Heater::feedforward), i.e.
+//    dT/dt = A * output - B * (T - ambient)
+// by least squares. The rate of change is measured over a few periods, and
+// the start of each phase is skipped, while the heat stored in the heater
+// spreads through the bed.
+static const auto MaxOutput = PidController::MaxOutput;
+static const uint8_t Window = 5;              // periods
+static const unsigned long SettleTime = 20000;
+static const float MaxOvershoot = 20.0f;
+
+static int s_fail(const __FlashStringHelper* reason) {
+  logError << F("Unable to identify bed model, ") << reason << endl;
+  vone->heater.setManualOutput(-1);
+  vone->heater.setTargetTemperature(0);
+  return -1;
+}
+
+int identifyBedHeaterModel(float target, int coolingSeconds) {
+  Heater& heater = vone->heater;
+  if (target < 40 || target > 240) {
+    logError << F("Unable to identify bed model, target must be between 40 and 240C") << endl;
+    return -1;
+  }
+  if (coolingSeconds < 60 || coolingSeconds > 1800) {
+    logError << F("Unable to identify bed model, cooling time must be between 60 and 1800s") << endl;
+    return -1;
+  }
+  if (heater.currentTemperature() > target - 20) {
+    logError
+      << F("Unable to identify bed model, the bed must be at least 20C below the target, current temperature is ")
+      << heater.currentTemperature()
+      << endl;
+    return -1;
+  }
+
+  log << F("Identifying bed model, heating to ") << target << F("C then cooling for ") << coolingSeconds << F("s") << endl;
+
+  // The target is only used for reporting (e.g. M105)
+  heater.setTargetTemperature(target);
+  heater.setManualOutput(MaxOutput);
+
+  // Sums for the normal equations, with x1 = output (0 or 1), x2 = -(T - ambient)
+  float s11 = 0, s12 = 0, s22 = 0, s1y = 0, s2y = 0;
+  unsigned samples = 0;
+
+  float window[Window];
+  uint8_t windowed = 0;
+  uint8_t next = 0;
+
+  bool heating = true;
+  auto phaseStart = millis();
+  auto nextSampleAt = phaseStart;
+  const float period = BED_PID_PERIOD_MS / 1000.0f;
+
+  for (;;) {
+    periodic_work();
+
+    const auto now = millis();
+    if (now < nextSampleAt) {
+      continue;
+    }
+    nextSampleAt = now + BED_PID_PERIOD_MS;
+
+    const auto current = heater.currentTemperature();
+    if (current > target + MaxOvershoot) {
+      return s_fail(F("temperature is too high"));
+    }
+
+    if (heating) {
+      if (current >= target) {
+        log << F("Reached ") << current << F("C in ") << (now - phaseStart) / 1000 << F("s, cooling") << endl;
+        heating = false;
+        heater.setManualOutput(0);
+        phaseStart = now;
+        windowed = 0;
+      } else if (now - phaseStart > minutes(20)) {
+        return s_fail(F("timed out heating to the target"));
+      }
+    } else if (now - phaseStart >= seconds(coolingSeconds)) {
+      break;
+    }
+
+    if (now - phaseStart < SettleTime) {
+      continue;
+    }
+
+    // Rate of change over the window, at the window's mid-point
+    if (windowed == Window) {
+      const float oldest = window[next];
+      const float y = (current - oldest) / (Window * period);
+      const float x1 = heating ? 1.0f : 0.0f;
+      const float x2 = -((current + oldest) / 2.0f - BED_AMBIENT_TEMP);
+      s11 += x1 * x1;
+      s12 += x1 * x2;
+      s22 += x2 * x2;
+      s1y += x1 * y;
+      s2y += x2 * y;
+      ++samples;
+    } else {
+      ++windowed;
+    }
+    window[next] = current;
+    next = (next + 1) % Window;
+  }
+
+  heater.setManualOutput(-1);
+  heater.setTargetTemperature(0);
+
+  const float det = s11 * s22 - s12 * s12;
+  if (samples < 20 || det == 0) {
+    logError << F("Unable to identify bed model, not enough samples (") << samples << F(")") << endl;
+    return -1;
+  }
+  const float a = (s1y * s22 - s12 * s2y) / det;
+  const float b = (s11 * s2y - s12 * s1y) / det;
+  if (a <= 0 || b <= 0) {
+    logError
+      << F("Unable to identify bed model, fit is not physical, A:") << FloatWithFormat(a, 4)
+      << F(" B:") << FloatWithFormat(b, 6)
+      << endl;
+    return -1;
+  }
+
+  bedModelA = a;
+  bedModelB = b;
+  heater.updateSettings();
+  Config_StoreSettings();
+
+  log
+    << F("Bed model identified from ") << samples << F(" samples, max temperature ")
+    << BED_AMBIENT_TEMP + a / b << F("C")
+    << endl;
+  log << F("  M306 A") << FloatWithFormat(bedModelA, 4) << F(" B") << FloatWithFormat(bedModelB, 6) << endl;
+  return 0;
+}
+
+#endif
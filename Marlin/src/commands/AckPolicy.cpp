@@ -0,0 +1,55 @@
+#include "AckPolicy.h"
+#include "binaryCommand.h"
+#include "../utils/parseNumber.h"
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+// Commands acknowledged on receipt, everything else is acknowledged after processing
+struct AckOnReceipt {
+  char prefix;
+  uint8_t code;
+};
+
+static const AckOnReceipt s_ackOnReceipt[] PROGMEM = {
+  { 'G', 0 },  // Coordinated movement
+  { 'G', 1 },
+  { 'G', 90 }, // Absolute/relative coordinates
+  { 'G', 91 },
+  { 'M', 82 }, // Absolute/relative E
+  { 'M', 83 },
+};
+
+AckPolicy ackPolicy(const char* command) {
+  if (binaryCommand::isBinary(command)) {
+    return binaryCommand::opcode(command) == binaryCommand::Move
+      ? AckPolicy::OnReceipt
+      : AckPolicy::AfterProcessing;
+  }
+
+  // Skip spaces (same as command_prefix_seen)
+  while (*command == ' ') {
+    ++command;
+  }
+
+  // Usage requests output text
+  if (strchr(command, '?')) {
+    return AckPolicy::AfterProcessing;
+  }
+
+  const char* end = nullptr;
+  const auto code = parseLong(command + 1, &end);
+  if (end == command + 1) {
+    return AckPolicy::AfterProcessing;
+  }
+
+  for (const auto& entry : s_ackOnReceipt) {
+    if (
+      pgm_read_byte(&entry.prefix) == command[0] &&
+      pgm_read_byte(&entry.code) == code
+    ) {
+      return AckPolicy::OnReceipt;
+    }
+  }
+  return AckPolicy::AfterProcessing;
+}
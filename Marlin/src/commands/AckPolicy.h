@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+// When a command is acknowledged (i.e. when its ok is sent)
+//   OnReceipt       -- when the command is queued, used for commands that only
+//                      enqueue moves into the planner (or set modal state used by
+//                      those moves). This lets the host send the next command while
+//                      the current one waits for room in the planner, keeping the
+//                      planner full.
+//   AfterProcessing -- when the command has been processed, so the host can treat
+//                      the ok as 'done' (and any output will precede the ok).
+// Note: errors from a command acknowledged on receipt are reported after its ok,
+//       so acknowledging on receipt is limited to the windowed protocol (see
+//       M130), where errors are tagged with the line number of the command
+//       being processed (see logError), so the host can match them to lines.
+//       Without it, every command is acknowledged after processing.
+// Note: arcs (G2/G3) are acknowledged after processing, they are split into
+//       many moves and can fail (e.g. an invalid radius) after being queued
+enum class AckPolicy : uint8_t {
+  OnReceipt,
+  AfterProcessing
+};
+
+AckPolicy ackPolicy(const char* command);
@@ -1,44 +1,143 @@
 #include "./CommandQueue.h"
 
 #include "../../Marlin.h"
+#include "binaryCommand.h"
 
-void CommandQueue::push(const char* command) {
-  if (full()) {
-    logError << F("Unable to process command, command queue is full -- ") << command << endl;
+static const uint8_t WrapMarker = 0;
+
+static const char* s_printable(const char* command) {
+  return binaryCommand::isBinary(command) ? "<binary>" : command;
+}
+
+bool CommandQueue::fits(unsigned int commandSize) const {
+  const auto size = sizeof(Header) + commandSize;
+  const auto available = COMMAND_BUFFER_SIZE - used_bytes;
+  const auto untilEnd = COMMAND_BUFFER_SIZE - write_index;
+
+  // If the command does not fit before the end of the ring,
+  // the bytes until the end are skipped
+  return size <= untilEnd ? size <= available : untilEnd + size <= available;
+}
+
+unsigned int CommandQueue::freeSlots() const {
+  // Place commands of MAX_CMD_SIZE one after another, the way push does
+  const auto size = sizeof(Header) + MAX_CMD_SIZE;
+  auto available = COMMAND_BUFFER_SIZE - used_bytes;
+  auto index = write_index;
+  unsigned int slots = 0;
+  while (commands_in_queue + slots < BUFSIZE) {
+    const auto untilEnd = COMMAND_BUFFER_SIZE - index;
+    const auto needed = size <= untilEnd ? size : untilEnd + size;
+    if (needed > available) {
+      break;
+    }
+    available -= needed;
+    index = (size <= untilEnd ? index : 0) + size;
+    if (index == COMMAND_BUFFER_SIZE) {
+      index = 0;
+    }
+    ++slots;
+  }
+  return slots;
+}
+
+CommandQueue::Header CommandQueue::frontHeader() const {
+  Header header = {};
+  if (!empty()) {
+    memcpy(&header, &buffer[read_index], sizeof(header));
+  }
+  return header;
+}
+
+const char* CommandQueue::front() const {
+  if (empty()) {
+    return "";
+  }
+  return reinterpret_cast<const char*>(&buffer[read_index + sizeof(Header)]);
+}
+
+void CommandQueue::push(const char* command, uint16_t lineNumber, bool isAcknowledged) {
+  const auto commandSize = binaryCommand::storedSize(command);
+  if (commands_in_queue == BUFSIZE || !fits(commandSize)) {
+    logError << F("Unable to process command, command queue is full -- ") << s_printable(command) << endl;
     return;
   }
 
-  strcpy(&commands[write_index][0], command);
-  ++commands_in_queue;
-  ++write_index;
-  if (write_index == BUFSIZE) {
+  // Wrap, if the command does not fit before the end of the ring
+  const auto size = sizeof(Header) + commandSize;
+  if (size > COMMAND_BUFFER_SIZE - write_index) {
+    buffer[write_index] = WrapMarker;
+    used_bytes += COMMAND_BUFFER_SIZE - write_index;
+    write_index = 0;
+  }
+
+  const Header header = {
+    uint8_t(commandSize),
+    lineNumber,
+    isAcknowledged,
+#if ENABLED(PROTOCOL_STATS)
+    uint16_t(millis())
+#endif
+  };
+  memcpy(&buffer[write_index], &header, sizeof(header));
+  memcpy(&buffer[write_index + sizeof(header)], command, commandSize);
+  used_bytes += size;
+  write_index += size;
+  if (write_index == COMMAND_BUFFER_SIZE) {
     write_index = 0;
   }
 
+  ++commands_in_queue;
+  if (!isAcknowledged) {
+    ++unacknowledged_commands;
+  }
+
   if (logging_enabled) {
     log
-      << F("Enqueued command '") << command
+      << F("Enqueued command '") << s_printable(command)
       << F("' commands_in_queue=") << commands_in_queue
+      << F(" used_bytes=") << used_bytes
       << F(" write_index=") << write_index
       << endl;
   }
 }
 
 void CommandQueue::pop() {
+  if (empty()) {
+    return;
+  }
+
   if (logging_enabled) {
-    log << F("Dequeued command '") << front() << F("'") << endl;
+    log << F("Dequeued command '") << s_printable(front()) << F("'") << endl;
   }
 
-  commands[read_index][0] = 0; // write a empty string to make it clear this command is done
+  const auto header = frontHeader();
+  const auto size = sizeof(Header) + header.size;
   --commands_in_queue;
-  ++read_index;
-  if (read_index == BUFSIZE) {
+  if (!header.acknowledged) {
+    --unacknowledged_commands;
+  }
+
+  if (empty()) {
+    // Start over, so the next commands do not need to wrap
+    used_bytes = 0;
+    write_index = 0;
     read_index = 0;
+  } else {
+    used_bytes -= size;
+    read_index += size;
+
+    // Skip to the start of the ring, if the next command was wrapped
+    if (read_index == COMMAND_BUFFER_SIZE || buffer[read_index] == WrapMarker) {
+      used_bytes -= COMMAND_BUFFER_SIZE - read_index;
+      read_index = 0;
+    }
   }
 
   if (logging_enabled) {
     log
       << F(" commands_in_queue=") << commands_in_queue
+      << F(" used_bytes=") << used_bytes
       << F(" read_index=") << read_index
       << endl;
   }
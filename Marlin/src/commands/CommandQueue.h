@@ -1,29 +1,62 @@
 #pragma once
 
+#include <stdint.h>
+#include "../../macros.h"
 #include "../../Configuration.h"
 
-// TODO: remove CommandQueue, we only handle one command at a time
-//       handling multiple would require a different approach to handling
-//       async errors (i.e. requesting a resend of only the most recent
-//       message will not be enough).
+#if COMMAND_BUFFER_SIZE < MAX_CMD_SIZE + 4 || COMMAND_BUFFER_SIZE > 0xFFFF
+  #error "COMMAND_BUFFER_SIZE must be large enough for a command of MAX_CMD_SIZE (plus a 4 byte header)"
+#endif
+
+// Commands that have been received, but not processed
+// Commands are packed into a ring of COMMAND_BUFFER_SIZE bytes, each with a
+// small header, so typical commands (20-30 bytes) use a fraction of the space
+// of the longest command (MAX_CMD_SIZE). A command is never split across the
+// end of the ring; if it does not fit, a wrap marker is written and the
+// command is stored at the start. At most BUFSIZE commands are queued.
+// Note: the host only sends one command at a time, unless the windowed
+//       protocol is enabled (see process_serial_commands.cpp), in which case
+//       it keeps several commands in flight.
 class CommandQueue {
 public:
-  CommandQueue() {
-    // initialize the first entry to an empty string
-    commands[read_index][0] = 0;
-  };
+  CommandQueue() {};
 
-  void push(const char* command);
+  void push(const char* command, uint16_t lineNumber = 0, bool acknowledged = false);
   void pop();
 
-  const char* front() { return &commands[read_index][0]; }
-  bool full() { return commands_in_queue == BUFSIZE; }
-  bool empty() { return commands_in_queue == 0; }
+  // Note: returns an empty string if the queue is empty
+  const char* front() const;
+  uint16_t frontLineNumber() const { return frontHeader().lineNumber; }
+  bool frontAcknowledged() const { return frontHeader().acknowledged; }
+#if ENABLED(PROTOCOL_STATS)
+  uint16_t frontReceivedAt() const { return frontHeader().receivedAt; }
+#endif
+  bool allAcknowledged() const { return unacknowledged_commands == 0; }
+
+  // Full when a command of MAX_CMD_SIZE might not fit
+  bool full() const { return commands_in_queue == BUFSIZE || !fits(MAX_CMD_SIZE); }
+  bool empty() const { return commands_in_queue == 0; }
+  // The number of MAX_CMD_SIZE commands that are sure to fit (reported in acks)
+  unsigned int freeSlots() const;
   void flush();
 
 private:
-  char commands[BUFSIZE][MAX_CMD_SIZE];
-  unsigned int commands_in_queue = 0;
+  struct Header {
+    uint8_t size;        // of the command, including the terminator (0 marks a wrap)
+    uint16_t lineNumber; // the line number the command was received on, used in acks
+    bool acknowledged;   // the ok was sent when the command was received (see AckPolicy.h)
+#if ENABLED(PROTOCOL_STATS)
+    uint16_t receivedAt; // millis(), truncated, used to measure ack latency
+#endif
+  };
+
+  uint8_t buffer[COMMAND_BUFFER_SIZE];
+  unsigned int used_bytes = 0; // including bytes skipped by a wrap
   unsigned int write_index = 0;
   unsigned int read_index = 0;
+  unsigned int commands_in_queue = 0;
+  unsigned int unacknowledged_commands = 0;
+
+  bool fits(unsigned int commandSize) const;
+  Header frontHeader() const;
 };
@@ -0,0 +1,72 @@
+#include "binaryCommand.h"
+
+#if ENABLED(BINARY_COMMANDS)
+
+#include "processing.h"
+#include "../../Marlin.h"
+
+static int32_t s_readInt32(const uint8_t*& ptr) {
+  const uint32_t value = (
+    uint32_t(ptr[0]) |
+    (uint32_t(ptr[1]) << 8) |
+    (uint32_t(ptr[2]) << 16) |
+    (uint32_t(ptr[3]) << 24)
+  );
+  ptr += 4;
+  return value;
+}
+
+static uint16_t s_readUInt16(const uint8_t*& ptr) {
+  const uint16_t value = ptr[0] | (ptr[1] << 8);
+  ptr += 2;
+  return value;
+}
+
+static int s_move(const uint8_t* payload, uint8_t size) {
+  const uint8_t axes = payload[0];
+  auto expectedSize = 1u;
+  for (auto i = 0; i < NUM_AXIS; ++i) {
+    if (axes & (1 << i)) {
+      expectedSize += 4;
+    }
+  }
+  if (axes & binaryCommand::MoveFeedrate) {
+    expectedSize += 2;
+  }
+  if (size != expectedSize) {
+    logError
+      << F("Unable to process binary move, expected ") << expectedSize
+      << F(" bytes, received ") << size
+      << endl;
+    return -1;
+  }
+
+  const uint8_t* ptr = payload + 1;
+  float position[NUM_AXIS];
+  for (auto i = 0; i < NUM_AXIS; ++i) {
+    position[i] = (axes & (1 << i)) ? s_readInt32(ptr) / 1000.0f : 0.0f;
+  }
+  const float feedrate = (axes & binaryCommand::MoveFeedrate) ? s_readUInt16(ptr) : 0.0f;
+
+  return process_gcode_move(position, axes, feedrate);
+}
+
+int process_binary_command() {
+  const char* command = command_queue.front();
+  const auto payload = binaryCommand::payload(command);
+  const auto size = binaryCommand::payloadSize(command);
+
+  switch (binaryCommand::opcode(command)) {
+    case binaryCommand::Move:
+      return s_move(payload, size);
+
+    default:
+      logError
+        << F("Unable to process binary command, unknown opcode ")
+        << binaryCommand::opcode(command)
+        << endl;
+      return -1;
+  }
+}
+
+#endif
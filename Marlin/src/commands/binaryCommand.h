@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../../MarlinConfig.h"
+
+// Binary commands
+// A compact alternative to text commands (mainly for moves), that avoids
+// formatting and parsing numbers. A frame is sent as
+//   0x00, data (COBS encoded), 0x00
+// where the data is
+//   opcode        uint8
+//   line number   uint16
+//   payload       depends on the opcode
+//   checksum      uint16, crc16 of the opcode, line number and payload
+// Multi-byte values are little-endian. Binary and text commands can be mixed,
+// they share line numbers, and are acknowledged (or resent) the same way.
+// See binary_commands.py for an encoder.
+//
+// Opcodes
+//   Move (0x01) -- same as G1
+//     axes        uint8, bit 0-3 set if X, Y, Z or E is included, bit 4 if F is included
+//     X, Y, Z, E  int32, in micrometers (only the included axes)
+//     F           uint16, in mm/min (if included)
+namespace binaryCommand {
+  enum Opcode : uint8_t {
+    Move = 0x01
+  };
+  const uint8_t MoveFeedrate = 0x10; // bit set in axes, if F is included
+
+  const unsigned MinimumFrameSize = 5; // opcode, line number and checksum
+
+  // In the command queue, binary commands are stored as
+  //   marker, size (of the opcode and payload), opcode, payload
+  // Note: text commands are stored as strings, which never start with the marker
+  const char Marker = '\x01';
+
+  inline bool isBinary(const char* command) { return command[0] == Marker; }
+  inline uint8_t opcode(const char* command) { return command[2]; }
+  inline uint8_t payloadSize(const char* command) { return command[1] - 1; }
+  inline const uint8_t* payload(const char* command) { return reinterpret_cast<const uint8_t*>(command + 3); }
+
+  // The number of bytes needed to store the command (binary or text)
+  inline unsigned storedSize(const char* command) {
+    return isBinary(command) ? 2 + uint8_t(command[1]) : strlen(command) + 1;
+  }
+}
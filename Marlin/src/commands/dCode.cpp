@@ -2,8 +2,10 @@
 #include "../api/diagnostics/diagnostics.h"
 #include "../vone/VOne.h"
 #include "../vone/endstops/ScopedEndstopEnable.h"
+#include "../vone/stepper/StepperTrace.h"
 #include "../../Marlin.h"
 #include "../utils/rawToVoltage.h"
+#include "../work/work.h"
 
 #include "processing.h"
 
@@ -172,7 +174,13 @@ int process_dcode(int command_code) {
           vone->stepper.resume();
         } else {
           log << F("Stopping stepper") << endl;
-          vone->stepper.stop(F("movement explicitly stopped by D5 command"));
+          auto& stepper = vone->stepper;
+          stepper.stop(F("movement explicitly stopped by D5 command"), true);
+
+          // No steps were lost while decelerating, so the position is still
+          // known. Bring the planner back in line with the step counts
+          stepper.finishPendingMoves();
+          stepper.resyncWithStepCount(true, true, true, true);
         }
       }
 
@@ -185,6 +193,28 @@ int process_dcode(int command_code) {
       return 0;
     }
 
+    // Output stepper trace
+    case 6:
+      #if ENABLED(STEPPER_TRACE)
+        return stepperTrace::dump();
+      #else
+        logError << F("Unable to output stepper trace, STEPPER_TRACE is not enabled") << endl;
+        return -1;
+      #endif
+
+    // Output protocol stats, R to reset
+    case 7:
+      #if ENABLED(PROTOCOL_STATS)
+        if (code_seen('R')) {
+          resetProtocolStats();
+        }
+        outputProtocolStats();
+        return 0;
+      #else
+        logError << F("Unable to output protocol stats, PROTOCOL_STATS is not enabled") << endl;
+        return -1;
+      #endif
+
     // Algorithms - prepare to move
     case 101:
       return tool.prepareToMove();
@@ -421,6 +451,8 @@ int process_dcode(int command_code) {
       log << F("  D2 - Output status, including switches and stats") << endl;
       log << F("  D3 - Toggle voltage logging for pogo pins") << endl;
       log << F("  D5 - stepper stop/resume -- D5 E1 to resume, E0 to stop, no args for status") << endl;
+      log << F("  D6 - output stepper trace, hex encoded (requires STEPPER_TRACE)") << endl;
+      log << F("  D7 - output protocol stats (requires PROTOCOL_STATS) -- D7 R to reset") << endl;
       log << F("") << endl;
       log << F("Algorithms") << endl;
       log << F("  D101 - prepare tool to move") << endl;
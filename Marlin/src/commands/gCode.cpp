@@ -69,6 +69,25 @@ static void s_prepare_move() {
   memcpy(current_position, destination, sizeof(current_position));
 }
 
+// G1, with arguments that have already been parsed (used by binary commands)
+// Note: bit i of axes is set if position[i] was given, a feedrate <= 0 is ignored
+int process_gcode_move(const float position[NUM_AXIS], uint8_t axes, float newFeedrate) {
+  for(int8_t i=0; i < NUM_AXIS; i++) {
+    if (axes & (1 << i)) {
+      destination[i] = position[i] + (axis_relative_modes[i] || relative_mode) * current_position[i];
+    } else {
+      destination[i] = current_position[i];
+    }
+  }
+
+  if (newFeedrate > 0.0) {
+    feedrate = newFeedrate;
+  }
+
+  s_prepare_move();
+  return 0;
+}
+
 static void s_get_arc_coordinates()
 {
 #ifdef SF_ARC_FIX
@@ -143,7 +162,7 @@ int process_gcode(int command_code) {
     case 4: {
       unsigned long delayMillis = 0;
       if(code_seen('P')) delayMillis = code_value(); // milliseconds to wait
-      if(code_seen('S')) delayMillis = code_value() * 1000; // seconds to wait
+      if(code_seen('S')) delayMillis = code_value_fixed(3); // seconds to wait, in milliseconds
 
       st_synchronize();
       safe_delay(delayMillis);
@@ -27,7 +27,7 @@ int process_mcode(int command_code) {
     //       timeout, after which the steppers will be disabled.  S0 to disable the timeout.
     case 18:
       if (code_seen('S')) {
-        setStepperInactiveDuration(code_value() * 1000);
+        setStepperInactiveDuration(code_value_fixed(3)); // seconds, in milliseconds
       } else {
         st_synchronize();
         vone->toolBox.currentTool().resetPreparations();
@@ -97,8 +97,11 @@ int process_mcode(int command_code) {
         << endl;
       return 0;
 
+    // M112 - Stop movement (decelerating, so no steps are lost)
     case 112:
-      quickStop();
+      decelerateToStop();
+      st_synchronize();
+
       // Reset the planner to the stepper counts in some axes
       return vone->stepper.resyncWithStepCount(
         code_seen('X'),
@@ -177,25 +180,61 @@ int process_mcode(int command_code) {
       return 0;
     }
 
-    // M140 - Set bed target temp
+    // M130 - Command protocol, W1 to allow several commands in flight (windowed), W0 for one at a time
+    case 130:
+      if (code_seen('W')) {
+        setWindowedProtocol(code_value_long());
+      }
+      log << F("Windowed protocol:") << windowedProtocol() << F(" window:") << BUFSIZE << endl;
+      return 0;
+
+#if ENABLED(BINARY_TELEMETRY)
+    // M131 - Binary telemetry, S<period in ms>, S0 to stop
+    case 131:
+      if (code_seen('S')) {
+        const auto period = code_value_long();
+        if (period != 0 && period < 10) {
+          logError << F("Unable to output telemetry, period must be at least 10ms") << endl;
+          return -1;
+        }
+        setTelemetryPeriod(period);
+      }
+      log
+        << F("Telemetry period:") << telemetryPeriod()
+        << F("ms skipped:") << telemetrySkipped()
+        << endl;
+      return 0;
+#endif
+
+    // M140 - Set bed target temp, optionally ramping at R<C/s> -- M140 S150 R0.5
     case 140:
       if (code_seen('S')) {
-        vone->heater.setTargetTemperature(code_value());
+        const float target = code_value();
+        const float rampRate = code_seen('R') ? code_value() : 0;
+        if (rampRate < 0) {
+          logError << F("Unable to set bed temperature, ramp rate must be positive") << endl;
+          return -1;
+        }
+        vone->heater.setTargetTemperature(target, rampRate);
       }
       return 0;
 
     // M141 - Append to profile
     //        M141 T240 D3600  => Heat to 240C and hold for 3600 seconds
+    //        M141 T150 D600 R0.2 => Ramp to 150C at 0.2C/s and hold for 600 seconds
     case 141: {
       int temperature = 0;
       int duration = 0;
+      float rate = 0;
       if (code_seen('T'))
         temperature = code_value();
       if (code_seen('D'))
         duration = code_value();
+      if (code_seen('R'))
+        rate = code_value();
 
       // Add the temperature
-      return profile_add(temperature, duration);
+      return profile_add(temperature, duration, rate);
     }
 
     // Stop the profile.
@@ -301,6 +340,72 @@ int process_mcode(int command_code) {
       }
       return 0;
 
+    // M290 - Babystep, adjust z without waiting for queued moves -- M290 Z0.01
+    case 290:
+      if (code_seen('Z')) {
+        if (vone->stepper.babystepZ(code_value())) {
+          return -1;
+        }
+      }
+      log << F("Babystep offset Z:") << vone->stepper.babystepOffsetZ() << endl;
+      return 0;
+
+#if ENABLED(PIDTEMPBED)
+    // M303 - Autotune the bed heater at S<temperature> for C<cycles>, stores the gains -- M303 S150 C5
+    case 303: {
+      const float target = code_seen('S') ? code_value() : 150;
+      const int cycles = code_seen('C') ? code_value_long() : 5;
+      return autotuneBedHeater(target, cycles);
+    }
+
+    // M304 - Set bed PID gains -- M304 P40 I4 D100, no args for status
+    case 304: {
+      const float kp = code_seen('P') ? code_value() : bedKp;
+      const float ki = code_seen('I') ? code_value() : bedKi;
+      const float kd = code_seen('D') ? code_value() : bedKd;
+      if (kp < 0 || ki < 0 || kd < 0) {
+        logError << F("Unable to set bed PID gains, gains must be positive") << endl;
+        return -1;
+      }
+      bedKp = kp;
+      bedKi = ki;
+      bedKd = kd;
+      vone->heater.updateSettings();
+      log
+        << F("Bed PID gains: P:") << bedKp
+        << F(" I:") << bedKi
+        << F(" D:") << bedKd
+        << F(" output:") << int(vone->heater.output())
+        << endl;
+      return 0;
+    }
+
+    // M306 - Bed model, identify by heating to S<temperature> and cooling for C<seconds> (stores
+    //        the model), or set A<heating rate, C/s> B<loss coefficient, 1/s>, no args for status
+    case 306: {
+      if (code_seen('S')) {
+        const float target = code_value();
+        const int coolingSeconds = code_seen('C') ? code_value_long() : 180;
+        return identifyBedHeaterModel(target, coolingSeconds);
+      }
+      const float a = code_seen('A') ? code_value() : bedModelA;
+      const float b = code_seen('B') ? code_value() : bedModelB;
+      if (a < 0 || b < 0) {
+        logError << F("Unable to set bed model, A and B must be positive") << endl;
+        return -1;
+      }
+      bedModelA = a;
+      bedModelB = b;
+      vone->heater.updateSettings();
+      log
+        << F("Bed model: A:") << FloatWithFormat(bedModelA, 4)
+        << F(" B:") << FloatWithFormat(bedModelB, 6)
+        << F(" setpoint:") << vone->heater.setpoint()
+        << endl;
+      return 0;
+    }
+#endif
+
     // M400 - Finish all moves
     case 400:
       st_synchronize();
@@ -314,12 +419,18 @@ int process_mcode(int command_code) {
     // M501 - reads parameters from EEPROM (if you need to reset them after you changed them temporarily).
     case 501:
       Config_RetrieveSettings();
+      #if ENABLED(PIDTEMPBED)
+        vone->heater.updateSettings();
+      #endif
       return 0;
 
     // M502 - reverts to the default "factory settings".
     //        include an 'S' to clear stored settings too.
     case 502: {
       Config_UseDefaultSettings();
+      #if ENABLED(PIDTEMPBED)
+        vone->heater.updateSettings();
+      #endif
 
       const auto save = code_seen('S');
       if (save) {
@@ -509,12 +620,23 @@ int process_mcode(int command_code) {
       log << F("Utilities") << endl;
       log << F("  M400 - Finish all moves") << endl;
       log << F("  M93  - Manually control LEDs. Set the RGB LEDs using R[1-255] G[1-255] B[1-255]") << endl;
+      log << F("  M130 - Command protocol, W1 to keep several commands in flight (windowed), W0 for one at a time") << endl;
+#if ENABLED(BINARY_TELEMETRY)
+      log << F("  M131 - Output binary telemetry every S milliseconds, S0 to stop -- M131 S20") << endl;
+#endif
       log << endl;
 
       log << F("Temperature") << endl;
       log << F("  M105 - Output current temperature") << endl;
-      log << F("  M141 - Append a temperature and duration to the heating profile (max 10 commands) -- M141 T200 D60") << endl;
+      log << F("  M140 - Set the bed temperature, optionally ramping at R C/s -- M140 S150 R0.5") << endl;
+      log << F("  M141 - Append a temperature, duration and optional ramp rate (C/s) to the heating profile (max ") << PROFILE_SIZE << F(" steps) -- M141 T200 D60 R0.5") << endl;
       log << F("  M142 - Stop heating and discard heating profile") << endl;
+#if ENABLED(PIDTEMPBED)
+      log << F("  M303 - Autotune the bed heater at a temperature, and store the gains -- M303 S150 C5") << endl;
+      log << F("  M304 - Set bed PID gains (M500 to store) -- M304 P40 I4 D100") << endl;
+      log << F("  M306 - Identify the bed model by heating to S and cooling for C seconds, and store it -- M306 S150 C180") << endl;
+      log << F("         or set it (M500 to store) -- M306 A1.6 B0.0015, A0 to disable") << endl;
+#endif
       log << endl;
 
       log << F("Status") << endl;
@@ -528,6 +650,10 @@ int process_mcode(int command_code) {
       log << F("  M17  - Enable (Power) all stepper motors") << endl;
       log << F("  M18  - Disable motors until next move -- M18 X Y Z E or M18 for all") << endl;
       log << F("         set inactivity timeout in seconds -- M18 S60, S0 to disable") << endl;
+      log << F("  M290 - Babystep Z, takes effect immediately (even while moving) -- M290 Z-0.01, no args for status") << endl;
+#if ENABLED(REALTIME_COMMANDS)
+      log << F("           bytes 0x85/0x86 babystep up/down without waiting for queued commands") << endl;
+#endif
       log << endl;
 
       log << F("Configuration") << endl;
@@ -1,13 +1,46 @@
 #include "processing.h"
 
-#include <stdlib.h>
 #include <string.h>
 
 #include "../../MarlinConfig.h" // millis()
+#include "../utils/parseNumber.h"
 
 CommandQueue command_queue;
 static const char* code_pointer = nullptr; // a pointer to find chars in the command string like X, Y, Z, E, etc
 
+// The offsets of the parameters (i.e. letters A-Z) of the current command,
+// found in a single pass, so that looking up a parameter does not need to
+// search the command. Values are parsed when they are asked for, since most
+// commands only use a few of theirs (see dispatch_benchmark.cpp).
+// Note: only the first occurrence of a letter is recorded (same as strchr),
+//       other characters are searched for
+static const uint8_t NotSeen = 0xFF;
+static uint8_t s_parameterOffsets[26];
+
+inline bool isParameter(char code) {
+  return code >= 'A' && code <= 'Z';
+}
+
+void tokenize_command() {
+  memset(s_parameterOffsets, NotSeen, sizeof(s_parameterOffsets));
+
+  const char* command = command_queue.front();
+  for (uint8_t i = 0; command[i]; ++i) {
+    const char ch = command[i];
+    if (isParameter(ch) && s_parameterOffsets[ch - 'A'] == NotSeen) {
+      s_parameterOffsets[ch - 'A'] = i;
+    }
+  }
+}
+
+static const char* s_find(char code) {
+  if (!isParameter(code)) {
+    return strchr(command_queue.front(), code);
+  }
+  const auto offset = s_parameterOffsets[code - 'A'];
+  return offset == NotSeen ? nullptr : command_queue.front() + offset;
+}
+
 bool command_prefix_seen(char prefix){
   const char* ptr = command_queue.front();
 
@@ -26,16 +59,20 @@ bool command_prefix_seen(char prefix){
 }
 
 bool code_seen(char code) {
-  code_pointer = strchr(command_queue.front(), code);
+  code_pointer = s_find(code);
   return (code_pointer != nullptr);  //Return true if the character was found
 }
 
 float code_value() {
-  return code_pointer ? strtod(code_pointer + 1, nullptr) : 0.0f;
+  return code_pointer ? parseFloat(code_pointer + 1) : 0.0f;
 }
 
 long code_value_long() {
-  return code_pointer ? strtol(code_pointer + 1, nullptr, 10) : 0l;
+  return code_pointer ? parseLong(code_pointer + 1) : 0l;
+}
+
+int32_t code_value_fixed(uint8_t decimals) {
+  return code_pointer ? parseFixed(code_pointer + 1, decimals) : 0l;
 }
 
 const char* code_value_raw() {
@@ -58,25 +95,25 @@ char code_prefix() {
 }
 
 float parseFloatArg(char argCode, float defaultValue) {
-  const char* ptr = strchr(command_queue.front(), argCode);
+  const char* ptr = s_find(argCode);
   if (ptr == nullptr) {
     return defaultValue;
   }
 
-  return strtod(ptr + 1, nullptr);
+  return parseFloat(ptr + 1);
 }
 
 long parseLongArg(char argCode, long defaultValue) {
-  const char* ptr = strchr(command_queue.front(), argCode);
+  const char* ptr = s_find(argCode);
   if (ptr == nullptr) {
     return defaultValue;
   }
 
-  return strtol(ptr + 1, nullptr, 10);
+  return parseLong(ptr + 1);
 }
 
 const char* parseStringArg(char argCode, char value[], int maxLen, const char* defaultValue) {
-  const char* argPtr = strchr(command_queue.front(), argCode);
+  const char* argPtr = s_find(argCode);
   if (argPtr == nullptr) {
     return defaultValue;
   }
@@ -12,11 +12,13 @@ long parseLongArg(char argCode, long defaultValue);
 const char* parseStringArg(char code, char value[], int maxLen, const char* defaultValue);
 
 
+void tokenize_command(); // find the parameters of the current command, call before processing it
 bool command_prefix_seen(char prefix); // check if the given prefix matches the first letter of the current command
 bool code_seen(char code); // find the given code
 
 float code_value(); // the float that follows the found code
 long code_value_long(); // the long that follows the found code
+int32_t code_value_fixed(uint8_t decimals); // the fixed-point number that follows the found code, e.g. seconds in milliseconds
 const char* code_value_raw(); // pointer to the char that follows the found code
 
 char code_prefix(); // the character before the found code
@@ -27,3 +29,6 @@ int process_mcode(int command_code = -1);
 int process_vcode(int command_code = -1);
 int process_dcode(int command_code = -1);
 int process_icode(int command_code = -1);
+
+int process_gcode_move(const float position[NUM_AXIS], uint8_t axes, float feedrate);
+int process_binary_command();
@@ -81,4 +81,20 @@ class LowWaterReporter: public Reporter {
         m_value = newValue;
       }
     }
-};
\ No newline at end of file
+};
+
+class CountReporter: public Reporter {
+  inline static const __FlashStringHelper* s_prefix() { return F("Count of "); }
+
+  public:
+    CountReporter(
+      const __FlashStringHelper* name,
+      const __FlashStringHelper* units,
+      unsigned long initialValue = 0
+    ): Reporter(s_prefix(), name, units, initialValue) {
+    }
+
+    FORCE_INLINE void update(unsigned long newValue) {
+      m_value = newValue;
+    }
+};
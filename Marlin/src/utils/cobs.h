@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Consistent Overhead Byte Stuffing, removes zeros from data so that zero can
+// be used to delimit frames. Each block of data is prefixed with a code byte,
+// the offset to the next zero (or 0xFF for a block of 254 bytes without a zero).
+// ref https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
+//
+// Decodes size bytes of data (not including the delimiter) into out, returns
+// the decoded size, or 0 if the data is not valid.
+// Note: out may be the same as data, i.e. data can be decoded in place.
+inline size_t cobsDecode(const uint8_t* data, size_t size, uint8_t* out) {
+  size_t read = 0;
+  size_t written = 0;
+  while (read < size) {
+    const uint8_t code = data[read++];
+    if (code == 0 || read + code - 1 > size) {
+      return 0;
+    }
+
+    for (uint8_t i = 1; i < code; ++i) {
+      const uint8_t byte = data[read++];
+      if (byte == 0) {
+        return 0;
+      }
+      out[written++] = byte;
+    }
+
+    // Each block ends in a zero, except full blocks and the last block
+    if (code != 0xFF && read < size) {
+      out[written++] = 0;
+    }
+  }
+  return written;
+}
+
+// The maximum size of size bytes of data once encoded (not including the delimiter)
+inline size_t cobsMaxEncodedSize(size_t size) {
+  return size + size / 254 + 1;
+}
+
+// Encodes size bytes of data, passing each encoded byte to output (the
+// delimiter is not included)
+template <typename Output>
+inline void cobsEncode(const uint8_t* data, size_t size, Output output) {
+  size_t start = 0;
+  while (true) {
+    // Find the end of this block, i.e. the next zero or 254 bytes
+    size_t end = start;
+    while (end < size && data[end] != 0 && end - start < 254) {
+      ++end;
+    }
+
+    output(uint8_t(end - start + 1));
+    for (size_t i = start; i < end; ++i) {
+      output(data[i]);
+    }
+
+    // A full block is not followed by a zero, so the next block starts at
+    // end (and may be empty)
+    if (end - start == 254) {
+      start = end;
+    } else if (end == size) {
+      return;
+    } else {
+      start = end + 1;
+    }
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+inline uint16_t crc16(const void* data, size_t size) {
+  const auto bytes = reinterpret_cast<const uint8_t*>(data);
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= uint16_t(bytes[i]) << 8;
+    for (uint8_t j = 0; j < 8; ++j) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
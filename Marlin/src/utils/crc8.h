@@ -1,17 +1,15 @@
 #pragma once
 
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// Dallas/Maxim crc8 (reflected polynomial 0x8C), table driven
 // ref https://stackoverflow.com/questions/29214301/ios-how-to-calculate-crc-8-dallas-maxim-of-nsdata
-unsigned char crc8(const void * data, const unsigned int size) {
-  const auto bytes = reinterpret_cast<const unsigned char*>(data);
-  unsigned char crc = 0;
-  for ( unsigned int i = 0; i < size; ++i ) {
-    unsigned char inbyte = bytes[i];
-    for ( unsigned char j = 0; j < 8; ++j ) {
-      unsigned char mix = (crc ^ inbyte) & 0x01;
-      crc >>= 1;
-      if ( mix ) crc ^= 0x8C;
-      inbyte >>= 1;
-    }
-  }
-  return crc;
-}
\ No newline at end of file
+extern const uint8_t crc8_table[256] PROGMEM;
+
+// Add a byte to the crc, start with a crc of 0
+inline uint8_t crc8_update(uint8_t crc, uint8_t byte) {
+  return pgm_read_byte(&crc8_table[crc ^ byte]);
+}
+
+uint8_t crc8(const void* data, unsigned int size);
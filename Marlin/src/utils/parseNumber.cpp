@@ -0,0 +1,136 @@
+#include "parseNumber.h"
+
+static const uint8_t MaxDigits = 9; // always fits in an int32
+static const int32_t MaxMantissa = 999999999L;
+static const int32_t MaxFixed = 0x7FFFFFFFL;
+
+static const int32_t s_powersOf10[MaxDigits + 1] = {
+  1L, 10L, 100L, 1000L, 10000L, 100000L, 1000000L, 10000000L, 100000000L, 1000000000L
+};
+
+static const char* s_skipSpaces(const char* ptr) {
+  while (*ptr == ' ') {
+    ++ptr;
+  }
+  return ptr;
+}
+
+static const char* s_parseSign(const char* ptr, bool& o_negative) {
+  o_negative = *ptr == '-';
+  if (*ptr == '-' || *ptr == '+') {
+    ++ptr;
+  }
+  return ptr;
+}
+
+inline bool isDigit(char ch) {
+  return ch >= '0' && ch <= '9';
+}
+
+const char* parseDecimal(const char* str, int32_t& o_mantissa, uint8_t& o_decimals) {
+  bool negative;
+  const char* ptr = s_parseSign(s_skipSpaces(str), negative);
+
+  int32_t mantissa = 0;
+  uint8_t digits = 0;
+  uint8_t decimals = 0;
+  bool seenDigit = false;
+  bool seenPoint = false;
+  for (;; ++ptr) {
+    const char ch = *ptr;
+    if (isDigit(ch)) {
+      seenDigit = true;
+      if (digits < MaxDigits && decimals < MaxDigits) {
+        mantissa = mantissa * 10 + (ch - '0');
+        if (mantissa) {
+          ++digits; // leading zeros are not significant
+        }
+        if (seenPoint) {
+          ++decimals;
+        }
+      } else if (!seenPoint) {
+        mantissa = MaxMantissa;
+      }
+    } else if (ch == '.' && !seenPoint) {
+      seenPoint = true;
+    } else {
+      break;
+    }
+  }
+
+  // No number
+  if (!seenDigit) {
+    o_mantissa = 0;
+    o_decimals = 0;
+    return str;
+  }
+
+  o_mantissa = negative ? -mantissa : mantissa;
+  o_decimals = decimals;
+  return ptr;
+}
+
+float parseFloat(const char* str, const char** o_end) {
+  int32_t mantissa;
+  uint8_t decimals;
+  const char* end = parseDecimal(str, mantissa, decimals);
+  if (o_end) {
+    *o_end = end;
+  }
+
+  // Note: powers of 10 up to 10^10 are exact floats, so this is a single rounding
+  return decimals ? float(mantissa) / float(s_powersOf10[decimals]) : float(mantissa);
+}
+
+int32_t parseFixed(const char* str, uint8_t decimals, const char** o_end) {
+  int32_t mantissa;
+  uint8_t parsedDecimals;
+  const char* end = parseDecimal(str, mantissa, parsedDecimals);
+  if (o_end) {
+    *o_end = end;
+  }
+
+  if (parsedDecimals <= decimals) {
+    // Saturate, rather than overflow
+    // Note: any non-zero mantissa overflows if scaled by more than 10^9
+    const uint8_t places = decimals - parsedDecimals;
+    if (mantissa == 0) {
+      return 0;
+    }
+    const int32_t limit = places <= MaxDigits ? MaxFixed / s_powersOf10[places] : 0;
+    if (mantissa > limit) {
+      return MaxFixed;
+    } else if (mantissa < -limit) {
+      return -MaxFixed;
+    }
+    return mantissa * s_powersOf10[places];
+  }
+
+  // Round half away from zero
+  const int32_t divisor = s_powersOf10[parsedDecimals - decimals];
+  const int32_t half = divisor / 2;
+  return (mantissa + (mantissa < 0 ? -half : half)) / divisor;
+}
+
+long parseLong(const char* str, const char** o_end) {
+  bool negative;
+  const char* ptr = s_parseSign(s_skipSpaces(str), negative);
+
+  if (!isDigit(*ptr)) {
+    if (o_end) {
+      *o_end = str;
+    }
+    return 0;
+  }
+
+  long value = 0;
+  while (isDigit(*ptr)) {
+    value = value * 10 + (*ptr - '0');
+    ++ptr;
+  }
+
+  if (o_end) {
+    *o_end = ptr;
+  }
+  return negative ? -value : value;
+}
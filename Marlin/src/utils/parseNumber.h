@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// Number parsing, a faster alternative to strtod and strtol
+// Like strtod/strtol, leading spaces and a sign are accepted, and the
+// pointer to the character after the number is output (or the start of the
+// string if there is no number). Unlike strtod, exponents are not supported,
+// since 'E' is an axis (i.e. "X1E2" is X1 followed by E2).
+
+// Parses a decimal number as a mantissa and the number of decimal places,
+// e.g. "-12.345" => -12345, 3
+// Note: digits beyond the 9th are ignored (after the decimal point), or
+//       saturate (before the decimal point)
+const char* parseDecimal(const char* str, int32_t& o_mantissa, uint8_t& o_decimals);
+
+// Parses a decimal number as a float
+// Note: the result is correctly rounded for numbers with at most 7 significant
+//       digits (e.g. 12345.67 or -0.000001), and within 1 ulp otherwise
+float parseFloat(const char* str, const char** o_end = nullptr);
+
+// Parses a decimal number as fixed-point, with the given number of
+// decimal places, rounding any extra places, e.g. "1.2345", 3 => 1235
+// Note: saturates at +/-(2^31 - 1), e.g. "3", 9 => 2147483647
+int32_t parseFixed(const char* str, uint8_t decimals, const char** o_end = nullptr);
+
+// Parses an integer
+long parseLong(const char* str, const char** o_end = nullptr);
@@ -1,6 +1,7 @@
 #include "VOne.h"
 
 #include "../libraries/MemoryFree/MemoryFree.h"
+#include "../../temperature_profile.h"
 
 VOne::VOne(
   int ptopDigitalPin,
@@ -27,6 +28,16 @@ VOne::VOne(
   , toolDetector(toolBox, pins.ptop)
 
   , m_memoryUsage(F("free memory"), F(" bytes"), 8192)
+  #if TX_BUFFER_SIZE > 0
+    , m_serialTxDropped(F("serial bytes dropped (transmit buffer full)"), F(" bytes"))
+    , m_serialTxStalled(F("serial bytes delayed (transmit buffer full)"), F(" bytes"))
+  #endif
+  #if ENABLED(SERIAL_STATS_RX)
+    , m_serialRxDropped(F("serial bytes dropped (receive buffer full)"), F(" bytes"))
+    , m_serialRxOverruns(F("serial receive overruns (byte arrived before previous was read)"), F(""))
+    , m_serialRxFramingErrors(F("serial receive framing errors"), F(""))
+    , m_serialRxQueued(F("serial receive buffer"), F(" bytes"))
+  #endif
 {
 }
 
@@ -52,6 +63,16 @@ void VOne::updateStats() {
   if (now > m_nextStatsCheckAt) {
     m_nextStatsCheckAt = now + 1000;
     m_memoryUsage.updateIfLower(freeMemory());
+    #if TX_BUFFER_SIZE > 0
+      m_serialTxDropped.update(MYSERIAL.txDropped());
+      m_serialTxStalled.update(MYSERIAL.txStalled());
+    #endif
+    #if ENABLED(SERIAL_STATS_RX)
+      m_serialRxDropped.update(MYSERIAL.rxDropped());
+      m_serialRxOverruns.update(MYSERIAL.rxOverruns());
+      m_serialRxFramingErrors.update(MYSERIAL.rxFramingErrors());
+      m_serialRxQueued.updateIfHigher(MYSERIAL.rxHighWater());
+    #endif
   }
 }
 
@@ -69,11 +90,13 @@ void VOne::frequentInterruptibleWork() {
   // Heater management
   // Note: Delaying heater updates (even for a few seconds) could
   //       result in several degrees of overshoot
-  // TODO: temperature profiles should be processed here
-  //       otherwise the next step in the profile can be delayed
-  //       by command processing
   heater.frequentInterruptibleWork();
 
+  // Temperature profile
+  // Note: processed here so the next step in the profile is not delayed
+  //       by command processing
+  manage_heating_profile();
+
   // Tool Detection
   // Note: Delaying tool detach detection (even for a few seconds) could
   //       result in damage, i.e. a tool crash, broken drill bit, etc
@@ -93,6 +116,16 @@ void VOne::frequentInterruptibleWork() {
 
 void VOne::outputStatus() {
   m_memoryUsage.outputStatus();
+  #if TX_BUFFER_SIZE > 0
+    m_serialTxDropped.outputStatus();
+    m_serialTxStalled.outputStatus();
+  #endif
+  #if ENABLED(SERIAL_STATS_RX)
+    m_serialRxDropped.outputStatus();
+    m_serialRxOverruns.outputStatus();
+    m_serialRxFramingErrors.outputStatus();
+    m_serialRxQueued.outputStatus();
+  #endif
   motors.outputStatus();
   stepper.outputStatus();
   endstops.outputStatus();
@@ -100,6 +133,16 @@ void VOne::outputStatus() {
 
 void VOne::periodicReport() {
   m_memoryUsage.reportIfChanged();
+  #if TX_BUFFER_SIZE > 0
+    m_serialTxDropped.reportIfChanged();
+    m_serialTxStalled.reportIfChanged();
+  #endif
+  #if ENABLED(SERIAL_STATS_RX)
+    m_serialRxDropped.reportIfChanged();
+    m_serialRxOverruns.reportIfChanged();
+    m_serialRxFramingErrors.reportIfChanged();
+    m_serialRxQueued.reportIfChanged();
+  #endif
   stepper.periodicReport();
   motors.reportChanges();
   endstops.reportChanges();
@@ -112,9 +155,20 @@ ISR(TIMER0_COMPB_vect) {
   DISABLE_TEMPERATURE_INTERRUPT();
   interrupts();
 
+  // Note: our output should not inherit the state of the line that
+  //       was being written (or recorded) when we interrupted
+  const auto lineState = MYSERIAL.saveLineState();
+  #if ENABLED(COMPACT_LOGGING)
+    logging::compact::SavedRecord record;
+    logging::compact::save(record);
+  #endif
   logging::inISR = true;
   vone->frequentInterruptibleWork();
   logging::inISR = false;
+  #if ENABLED(COMPACT_LOGGING)
+    logging::compact::restore(record);
+  #endif
+  MYSERIAL.restoreLineState(lineState);
 
   // Restore interrupt settings
   // Notes:
@@ -54,6 +54,16 @@ class VOne {
   private:
     unsigned long m_nextStatsCheckAt = 0;
     LowWaterReporter m_memoryUsage;
+    #if TX_BUFFER_SIZE > 0
+      CountReporter m_serialTxDropped;
+      CountReporter m_serialTxStalled;
+    #endif
+    #if ENABLED(SERIAL_STATS_RX)
+      CountReporter m_serialRxDropped;
+      CountReporter m_serialRxOverruns;
+      CountReporter m_serialRxFramingErrors;
+      HighWaterReporter m_serialRxQueued;
+    #endif
 
     void updateStats();
 
@@ -3,6 +3,7 @@
 #include "../../../../Marlin.h"
 #include "../../pins/HeaterPin.h"
 #include "../../pins/BedTemperaturePin/BedTemperaturePin.h"
+#include "PidController.h"
 
 class Heater {
   public:
@@ -10,10 +11,38 @@ class Heater {
 
     float currentTemperature() { return m_currentTemp; };
     float targetTemperature() { return m_targetTemp; };
-    inline void setTargetTemperature(float target);
+
+    // Ramps to the target at rampRate (C/s), if given, or jumps to it
+    // Notes:
+    //   1) With a bed model (see updateSettings), jumps are ramps at the rate
+    //      the heater can sustain, so the bed does not overshoot
+    //   2) Without PIDTEMPBED, the heater is switched on while colder than the
+    //      setpoint, so it ramps too, in bang-bang steps
+    inline void setTargetTemperature(float target, float rampRate = 0);
+
+    // As above, without logging, for use by interrupt handlers (e.g. the
+    // heating profile)
+    inline void changeTargetTemperature(float target, float rampRate = 0);
 
     bool isHeating() { ScopedInterruptDisable sid; return m_currentTemp < m_targetTemp; };
     bool isCooling() { return !isHeating(); };
+    bool heaterOn() const { return m_heaterPin.isHeating(); };
+
+    // The temperature the controller is aiming for now, i.e. along the ramp
+    float setpoint() { return m_setpoint; };
+
+    #if ENABLED(PIDTEMPBED)
+      // The output for the current period, 0 (off) to PidController::MaxOutput (on)
+      uint8_t output() { return m_output; };
+
+      // Use bedKp, bedKi, bedKd and the bed model (e.g. after M304 or M501)
+      inline void updateSettings();
+
+      // Drive the heater at a fixed output instead of the target (e.g. for
+      // M303), or a negative value to return to PID control
+      // Note: the heater is still shut off if the temperature is out of range
+      inline void setManualOutput(int16_t output);
+    #endif
 
     inline void frequentInterruptibleWork();
 
@@ -24,24 +53,144 @@ class Heater {
 
     volatile float m_currentTemp = 0.0f;
     volatile float m_targetTemp = 0.0f;
+    volatile float m_setpoint = 0.0f;
+    float m_rampRate = 0.0f;
+
+    // The control period
+    #if ENABLED(PIDTEMPBED)
+      static const unsigned long PeriodMs = BED_PID_PERIOD_MS;
+    #else
+      static const unsigned long PeriodMs = 500;
+    #endif
+
+    inline float advanceSetpoint();
+
+    #if ENABLED(PIDTEMPBED)
+      PidController m_pid;
+      unsigned long m_periodStart = 0;
+      volatile uint8_t m_output = 0;
+      volatile int16_t m_manualOutput = -1;
+
+      float m_modelA = 0.0f;
+      float m_modelB = 0.0f;
 
-    inline void updateHeating(float temperature);
+      inline uint8_t feedforward(float rate);
+      inline void updateOutput(unsigned long now);
+    #else
+      // The setpoint as a raw reading, so readings are compared without converting
+      volatile long m_targetRaw = 0;
+    #endif
+
+    inline void updateHeating(const BedTemperaturePin::Sample& sample);
 };
 
 Heater::Heater(HeaterPin& heaterPin, BedTemperaturePin &temperaturePin)
   : m_heaterPin(heaterPin)
   , m_temperaturePin(temperaturePin) {
+  #if ENABLED(PIDTEMPBED)
+    updateSettings();
+  #else
+    m_targetRaw = BedTemperaturePin::temperatureToRaw(m_targetTemp);
+  #endif
 }
 
-void Heater::setTargetTemperature(float target) {
-  {
-    ScopedInterruptDisable sid;
-    m_targetTemp = target;
+void Heater::changeTargetTemperature(float target, float rampRate) {
+  ScopedInterruptDisable sid;
+  m_targetTemp = target;
+
+  // Ramps start at the current temperature
+  m_rampRate = rampRate;
+  m_setpoint = m_currentTemp;
+  #if DISABLED(PIDTEMPBED)
+    m_targetRaw = BedTemperaturePin::temperatureToRaw(m_setpoint);
+  #endif
+}
+
+void Heater::setTargetTemperature(float target, float rampRate) {
+  changeTargetTemperature(target, rampRate);
+  if (rampRate > 0) {
+    log << F("New target Temperature: ") << target << F(", ramping at ") << rampRate << F("C/s") << endl;
+  } else {
+    log << F("New target Temperature: ") << target << endl;
   }
-  log << F("New target Temperature: ") << target << endl;
 };
 
-void Heater::updateHeating(float temperature) {
+// Moves the setpoint toward the target, returns the rate it moved at (C/s)
+// Note: the last BED_RAMP_SETTLE_TIME seconds of a ramp slow down, the
+//       thermistor lags the bed, so a bed that is tracking a ramp would
+//       overshoot when the ramp stops suddenly
+float Heater::advanceSetpoint() {
+  const float period = PeriodMs / 1000.0f;
+  const float remaining = m_targetTemp - m_setpoint;
+
+  float rate = m_rampRate;
+  if (rate <= 0) {
+    #if ENABLED(PIDTEMPBED)
+      // Jump, unless we have a model to ramp with (cooling can not be driven)
+      if (m_modelA <= 0 || remaining < 0) {
+        m_setpoint = m_targetTemp;
+        return 0;
+      }
+      rate = BED_MODEL_RATE_MARGIN * (m_modelA - m_modelB * (m_setpoint - BED_AMBIENT_TEMP));
+      NOLESS(rate, 0.05f);
+    #else
+      m_setpoint = m_targetTemp;
+      return 0;
+    #endif
+  }
+
+  const float distance = fabs(remaining);
+  if (distance < 0.1f) {
+    m_setpoint = m_targetTemp;
+    return 0;
+  }
+  float step = min(rate, distance / BED_RAMP_SETTLE_TIME) * period;
+  NOMORE(step, distance);
+  m_setpoint += remaining > 0 ? step : -step;
+  return (remaining > 0 ? step : -step) / period;
+}
+
+#if ENABLED(PIDTEMPBED)
+void Heater::updateSettings() {
+  ScopedInterruptDisable sid;
+  m_pid.setGains(bedKp, bedKi, bedKd, BED_PID_PERIOD_MS / 1000.0f);
+  m_modelA = bedModelA;
+  m_modelB = bedModelB;
+}
+
+// The output the model says holds the setpoint, and moves it at rate
+// i.e. dT/dt = A * output - B * (T - ambient)
+uint8_t Heater::feedforward(float rate) {
+  if (m_modelA <= 0) {
+    return 0;
+  }
+  const float output = (rate + m_modelB * (m_setpoint - BED_AMBIENT_TEMP)) / m_modelA;
+  return constrain(output, 0.0f, 1.0f) * PidController::MaxOutput;
+}
+
+void Heater::setManualOutput(int16_t output) {
+  ScopedInterruptDisable sid;
+  m_manualOutput = output > PidController::MaxOutput ? PidController::MaxOutput : output;
+  m_pid.reset();
+}
+
+// Time-proportional output, the heater is on for the first part of each period
+void Heater::updateOutput(unsigned long now) {
+  const unsigned long onTime = (unsigned long)m_output * BED_PID_PERIOD_MS / PidController::MaxOutput;
+  const bool on = now - m_periodStart < onTime;
+  if (on != m_heaterPin.isHeating()) {
+    if (on) {
+      m_heaterPin.startHeating();
+    } else {
+      m_heaterPin.stopHeating();
+    }
+  }
+}
+#endif
+
+void Heater::updateHeating(const BedTemperaturePin::Sample& sample) {
+  const float temperature = sample.temperature;
+
   // Shut off the heater if the temperature is out of range
   // Notes: A temp below the minimum suggests the thermometer is broken
   if (temperature < BED_MINTEMP || temperature > BED_MAXTEMP) {
@@ -53,29 +202,58 @@ void Heater::updateHeating(float temperature) {
       << F(" degrees, which is outside of the expected range, ") << BED_MINTEMP
       << F(" to ") << BED_MAXTEMP
       << endl;
+    #if ENABLED(PIDTEMPBED)
+      m_output = 0;
+      m_pid.reset();
+    #endif
     m_heaterPin.stopHeating();
     return;
   }
 
-  // Turn heater on/off
-  if (temperature < m_targetTemp) {
-    m_heaterPin.startHeating();
-  } else {
-    m_heaterPin.stopHeating();
-  }
+  #if ENABLED(PIDTEMPBED)
+    if (m_manualOutput >= 0) {
+      m_output = m_manualOutput;
+    } else {
+      const float rate = advanceSetpoint();
+      m_output = m_pid.update(
+        PidController::toFixed(m_setpoint),
+        PidController::toFixed(temperature),
+        feedforward(rate)
+      );
+    }
+  #else
+    // Note: the setpoint is only converted while it moves
+    if (m_setpoint != m_targetTemp) {
+      advanceSetpoint();
+      m_targetRaw = BedTemperaturePin::temperatureToRaw(m_setpoint);
+    }
+
+    // Turn heater on/off, i.e. on while colder than the setpoint
+    if (sample.raw > m_targetRaw) {
+      m_heaterPin.startHeating();
+    } else {
+      m_heaterPin.stopHeating();
+    }
+  #endif
 }
 
 void Heater::frequentInterruptibleWork() {
-  // Run every 0.5s
   const auto now = millis();
-  if (now < m_nextCheckAt) {
-    return;
-  }
-  m_nextCheckAt = now + 500;
+  if (now >= m_nextCheckAt) {
+    m_nextCheckAt = now + PeriodMs;
 
-  // Update currentTemp (i.e. volatile member)
-  m_currentTemp = m_temperaturePin.value().temperature;
+    // Update currentTemp (i.e. volatile member)
+    const auto sample = m_temperaturePin.value();
+    m_currentTemp = sample.temperature;
+
+    // Process the latest temperature
+    #if ENABLED(PIDTEMPBED)
+      m_periodStart = now;
+    #endif
+    updateHeating(sample);
+  }
 
-  // Process the latest temperature
-  updateHeating(m_currentTemp);
+  #if ENABLED(PIDTEMPBED)
+    updateOutput(now);
+  #endif
 }
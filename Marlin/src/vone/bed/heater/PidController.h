@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fixed-point PID controller, updated at a fixed period
+// Temperatures are in 1/16 C, gains are scaled by 256 and the terms are
+// summed with 12 fractional bits, so an update is a few integer multiplies.
+// Output is 0 (off) to MaxOutput (always on), see Heater.
+//
+// Gains use the same units as Marlin's M301/M304, i.e. output per C, per
+// C*s and per C/s, so gains from other tools (and M303) can be used as is.
+//
+// Notes:
+//   1) Outside of the functional range the output is full on (or off), and
+//      the integral is reset. The heater is far from the target, there is
+//      nothing to gain from integrating the error
+//   2) Anti-windup: the integral is limited to the output range, and it
+//      is not increased while the output is saturated
+//   3) The derivative is taken on the measurement (so target changes do
+//      not kick the output), and filtered, because the thermistor is noisy
+//   4) A feedforward output (see Heater) is added to the terms, and the
+//      integral is limited so the integral and feedforward together stay
+//      within the output range, i.e. the integral only corrects the model
+class PidController {
+  public:
+    static const uint8_t MaxOutput = 255;
+    static const int16_t TemperatureScale = 16;
+    static const int16_t FunctionalRange = 10 * TemperatureScale;
+
+    inline void setGains(float kp, float ki, float kd, float periodSeconds);
+    inline void reset();
+
+    // Returns the output for the next period
+    inline uint8_t update(int16_t target, int16_t current, uint8_t feedforward = 0);
+
+    static int16_t toFixed(float temperature) { return temperature * TemperatureScale; }
+
+  private:
+    static const uint8_t GainShift = 8;
+    static const uint8_t TermShift = 12;
+    static const int32_t MaxTerm = int32_t(MaxOutput) << TermShift;
+
+    int32_t m_kp = 0;
+    int32_t m_ki = 0;   // per period
+    int32_t m_kd = 0;   // per period
+    int32_t m_integral = 0;
+    int32_t m_derivative = 0;
+    int16_t m_previous = 0;
+    bool m_havePrevious = false;
+};
+
+void PidController::setGains(float kp, float ki, float kd, float periodSeconds) {
+  const float scale = 1 << GainShift;
+  m_kp = kp * scale;
+  m_ki = ki * scale * periodSeconds;
+  m_kd = kd * scale / periodSeconds;
+  reset();
+}
+
+void PidController::reset() {
+  m_integral = 0;
+  m_derivative = 0;
+  m_havePrevious = false;
+}
+
+uint8_t PidController::update(int16_t target, int16_t current, uint8_t feedforward) {
+  const int16_t error = target - current;
+
+  // Filtered derivative, updated even outside of the functional range so
+  // it is settled on entry
+  if (!m_havePrevious) {
+    m_previous = current;
+    m_havePrevious = true;
+  }
+  const int32_t derivative = -m_kd * (current - m_previous);
+  m_previous = current;
+  m_derivative += (derivative - m_derivative) / 4;
+
+  if (error > FunctionalRange) {
+    m_integral = 0;
+    return MaxOutput;
+  }
+  if (error < -FunctionalRange) {
+    m_integral = 0;
+    return 0;
+  }
+
+  const int32_t model = int32_t(feedforward) << TermShift;
+  const int32_t proportional = m_kp * error;
+  int32_t integral = m_integral + m_ki * error;
+  if (integral < -model) {
+    integral = -model;
+  } else if (integral > MaxTerm - model) {
+    integral = MaxTerm - model;
+  }
+
+  // Only integrate if it does not push the output further into saturation
+  const int32_t unclamped = proportional + integral + m_derivative + model;
+  const bool saturated = (unclamped > MaxTerm && error > 0) || (unclamped < 0 && error < 0);
+  if (!saturated) {
+    m_integral = integral;
+  }
+
+  const int32_t output = (proportional + m_integral + m_derivative + model) >> TermShift;
+  if (output < 0) {
+    return 0;
+  }
+  return output > MaxOutput ? MaxOutput : output;
+}
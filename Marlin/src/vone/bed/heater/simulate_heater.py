@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+
+""" Simulate bed temperature control against a model of the bed.
+
+Runs the firmware's controllers (see Heater.h, and PidController.h, which is
+built natively, see pid_controller.cpp in src/work/protocol_harness) against
+a thermal model of the bed, and reports the overshoot and settling time of each step of a
+profile. Compares bang-bang control to PID, with the given gains or gains
+found by the relay autotune (see M303, bedHeaterAutotune.cpp), and to PID
+with the bed model (see M306, bedHeaterModel.cpp), given or identified.
+
+The model has a heater element coupled to the plate, losses to ambient and
+a lagging, noisy thermistor. The defaults roughly match the V-One (heats at
+~2C/s, cools at ~0.1C/s), adjust them to match measurements, e.g. from M131
+telemetry (see decode_telemetry.py).
+
+Requires g++.
+"""
+
+import argparse
+import csv
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'work', 'protocol_harness'))
+import native_build  # noqa: E402
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('--kp', type=float, default=40.0, help='proportional gain (default=40, see DEFAULT_bedKp)')
+parser.add_argument('--ki', type=float, default=4.0, help='integral gain (default=4)')
+parser.add_argument('--kd', type=float, default=100.0, help='derivative gain (default=100)')
+parser.add_argument('--autotune', type=float, metavar='TEMP', help='autotune at TEMP, and use the resulting gains')
+parser.add_argument('--cycles', type=int, default=5, help='autotune cycles (default=5)')
+parser.add_argument('--model-a', type=float, default=0.0, help='bed model heating rate, C/s at full output (see M306)')
+parser.add_argument('--model-b', type=float, default=0.0, help='bed model losses, 1/s (see M306)')
+parser.add_argument('--identify', type=float, metavar='TEMP', help='identify the bed model at TEMP, and use it')
+parser.add_argument('--cooling', type=int, default=180, help='identification cooling time in seconds (default=180)')
+parser.add_argument('--profile', default='120:600,200:600,150:900,240:600',
+                    help='target:seconds[:rate] steps, rate in C/s ramps to the target, see M140 R '
+                         '(default=120:600,200:600,150:900,240:600)')
+parser.add_argument('--period', type=float, default=1.0, help='control period in seconds, see BED_PID_PERIOD_MS (default=1)')
+parser.add_argument('--heating-rate', type=float, default=2.0, help='C/s at full power, near ambient (default=2)')
+parser.add_argument('--loss-tau', type=float, default=600.0, help='time constant of losses to ambient, in seconds (default=600)')
+parser.add_argument('--coupling-tau', type=float, default=8.0, help='time constant from heater to plate, in seconds (default=8)')
+parser.add_argument('--sensor-tau', type=float, default=3.0, help='thermistor time constant, in seconds (default=3)')
+parser.add_argument('--noise', type=float, default=0.1, help='thermistor noise, +/- C (default=0.1)')
+parser.add_argument('--tolerance', type=float, default=1.0, help='settled when within +/- C (default=1)')
+parser.add_argument('--seed', type=int, default=1, help='random seed, for the noise')
+parser.add_argument('--csv', help='write the last PID run (time, setpoint, plate, sensor, output) to a file')
+parser.add_argument('--build-dir', help='directory to build the controller in (default=a temporary directory)')
+parser.add_argument('--cxx', default=os.environ.get('CXX', 'g++'), help='compiler (default=$CXX or g++)')
+args = parser.parse_args()
+
+AMBIENT = 25.0      # see BED_AMBIENT_TEMP
+RATE_MARGIN = 0.8   # see BED_MODEL_RATE_MARGIN
+SETTLE_TIME = 10.0  # see BED_RAMP_SETTLE_TIME
+DT = 0.05  # simulation step (s)
+CONTROLLER = None  # the native build of PidController.h, see simulate()
+
+
+class Bed:
+    """ Heater element -> plate -> ambient, read through a lagging thermistor """
+
+    def __init__(self):
+        self.heater = self.plate = self.sensor = AMBIENT
+
+    def step(self, on, dt):
+        # The element is a quarter of the heat capacity
+        power = args.heating_rate * 4 if on else 0
+        flow = (self.heater - self.plate) / args.coupling_tau
+        self.heater += dt * (power - flow * 4)
+        self.plate += dt * (flow - (self.plate - AMBIENT) / args.loss_tau)
+        self.sensor += dt * (self.plate - self.sensor) / args.sensor_tau
+
+    def read(self):
+        return self.sensor + random.uniform(-args.noise, args.noise)
+
+
+class Pid:
+    """ PidController.h, built natively (see pid_controller.cpp) """
+    MAX_OUTPUT = 255  # see PidController::MaxOutput
+
+    def __init__(self, kp, ki, kd, period):
+        self.process = subprocess.Popen(
+            [CONTROLLER], stdin=subprocess.PIPE, stdout=subprocess.PIPE, universal_newlines=True)
+        self.send('gains %r %r %r %r' % (kp, ki, kd, period))
+
+    def send(self, command):
+        self.process.stdin.write(command + '\n')
+        self.process.stdin.flush()
+
+    def update(self, target, current, feedforward=0):
+        self.send('update %r %r %d' % (target, current, feedforward))
+        return int(self.process.stdout.readline())
+
+    def close(self):
+        self.process.stdin.close()
+        if self.process.wait() != 0:
+            sys.exit('PID controller failed')
+
+
+class Setpoint:
+    """ See Heater::advanceSetpoint and Heater::feedforward """
+
+    def __init__(self, target, rate, current, model_a, model_b):
+        self.target = target
+        self.rate = rate
+        self.value = current
+        self.a = model_a
+        self.b = model_b
+
+    def advance(self):
+        remaining = self.target - self.value
+        rate = self.rate
+        if rate <= 0:
+            if self.a <= 0 or remaining < 0:
+                self.value = self.target
+                return 0.0
+            rate = max(0.05, RATE_MARGIN * (self.a - self.b * (self.value - AMBIENT)))
+        distance = abs(remaining)
+        if distance < 0.1:
+            self.value = self.target
+            return 0.0
+        step = min(rate, distance / SETTLE_TIME) * args.period
+        step = min(step, distance)
+        step = step if remaining > 0 else -step
+        self.value += step
+        return step / args.period
+
+    def feedforward(self, rate):
+        if self.a <= 0:
+            return 0
+        output = (rate + self.b * (self.value - AMBIENT)) / self.a
+        return int(max(0.0, min(1.0, output)) * Pid.MAX_OUTPUT)
+
+
+def run(controller, profile, model=(0.0, 0.0)):
+    """ Returns (time, setpoint, plate, sensor, output, step) every simulation step """
+    bed = Bed()
+    trace = []
+    t = 0.0
+    next_update = 0.0
+    period_start = 0.0
+    output = 0
+    for index, (target, duration, rate) in enumerate(profile):
+        end = t + duration
+        setpoint = Setpoint(target, rate, bed.sensor, *model)
+        while t < end:
+            if t >= next_update:
+                if controller is None:
+                    # Bang-bang, every 500ms
+                    next_update = t + 0.5
+                    output = Pid.MAX_OUTPUT if bed.read() < target else 0
+                else:
+                    next_update = t + args.period
+                    current = bed.read()
+                    feedforward = setpoint.feedforward(setpoint.advance())
+                    output = controller.update(setpoint.value, current, feedforward)
+                period_start = t
+            # Time-proportional output
+            on = t - period_start < output * args.period / Pid.MAX_OUTPUT
+            bed.step(on, DT)
+            t += DT
+            trace.append((t, setpoint.value if controller else target, bed.plate, bed.sensor, output, index))
+    if controller is not None:
+        controller.close()
+    return trace
+
+
+def autotune(target, cycles):
+    """ See bedHeaterAutotune.cpp, returns (kp, ki, kd) """
+    bed = Bed()
+    t = 0.0
+    next_sample = 0.0
+    period_start = 0.0
+    bias = amplitude = Pid.MAX_OUTPUT // 2
+    output = bias + amplitude
+    heating = True
+    high_start = low_start = 0.0
+    high_time = low_time = 0.0
+    max_temp, min_temp = 0.0, 10000.0
+    gains = None
+    cycle = 0
+    while cycle <= cycles:
+        if t > 3 * 3600:
+            sys.exit('Autotune did not complete, is the target reachable?')
+        if t >= next_sample:
+            next_sample = t + args.period
+            period_start = t
+            current = bed.read()
+            max_temp = max(max_temp, current)
+            min_temp = min(min_temp, current)
+            if heating and current > target and t - high_start > 5:
+                heating = False
+                output = bias - amplitude
+                low_start = t
+                high_time = low_start - high_start
+                max_temp = target
+            elif not heating and current < target and t - low_start > 5:
+                heating = True
+                high_start = t
+                low_time = high_start - low_start
+                if cycle > 0:
+                    # Note: C's integer division truncates
+                    bias += int(amplitude * (high_time - low_time) / (low_time + high_time))
+                    bias = max(20, min(Pid.MAX_OUTPUT - 20, bias))
+                    amplitude = Pid.MAX_OUTPUT - 1 - bias if bias > Pid.MAX_OUTPUT // 2 else bias
+                    ku = 4.0 * amplitude / (math.pi * (max_temp - min_temp) / 2.0)
+                    tu = low_time + high_time
+                    kp = 0.6 * ku
+                    gains = (kp, 2.0 * kp / tu, kp * tu / 8.0)
+                    print('Autotune cycle %d: bias:%d amplitude:%d Ku:%.2f Tu:%.1f' % (cycle, bias, amplitude, ku, tu))
+                output = bias + amplitude
+                min_temp = target
+                cycle += 1
+        on = t - period_start < output * args.period / Pid.MAX_OUTPUT
+        bed.step(on, DT)
+        t += DT
+    return gains
+
+
+def identify(target, cooling):
+    """ See bedHeaterModel.cpp, returns (a, b) """
+    bed = Bed()
+    window_size, settle_time = 5, 20.0
+    sums = [0.0] * 5  # s11, s12, s22, s1y, s2y
+    samples = 0
+    window = []
+    heating = True
+    t = phase_start = next_sample = 0.0
+    while True:
+        if t >= next_sample:
+            next_sample = t + args.period
+            current = bed.read()
+            if heating and current >= target:
+                heating = False
+                phase_start = t
+                window = []
+            elif not heating and t - phase_start >= cooling:
+                break
+            if t - phase_start >= settle_time:
+                if len(window) == window_size:
+                    oldest = window.pop(0)
+                    y = (current - oldest) / (window_size * args.period)
+                    x1 = 1.0 if heating else 0.0
+                    x2 = -((current + oldest) / 2 - AMBIENT)
+                    for i, v in enumerate((x1 * x1, x1 * x2, x2 * x2, x1 * y, x2 * y)):
+                        sums[i] += v
+                    samples += 1
+                window.append(current)
+        bed.step(heating, DT)
+        t += DT
+    s11, s12, s22, s1y, s2y = sums
+    det = s11 * s22 - s12 * s12
+    if samples < 20 or det == 0:
+        sys.exit('Unable to identify bed model, not enough samples (%d)' % samples)
+    return (s1y * s22 - s12 * s2y) / det, (s11 * s2y - s12 * s1y) / det
+
+
+def step_metrics(trace, profile):
+    """ Yields (target, overshoot, settling time, tracking error) for each step
+    The tracking error is the RMS of the sensor's distance from the setpoint,
+    while the setpoint is ramping
+    """
+    previous = AMBIENT
+    for index, (target, _, _) in enumerate(profile):
+        step = [x for x in trace if x[5] == index]
+        start = step[0][0]
+        # Overshoot past the target, in the direction of the change
+        if target >= previous:
+            overshoot = max(x[3] for x in step) - target
+        else:
+            overshoot = target - min(x[3] for x in step)
+        settled = None
+        for i in range(len(step)):
+            if all(abs(x[3] - target) <= args.tolerance for x in step[i:]):
+                settled = step[i][0] - start
+                break
+        ramp = [x[3] - x[1] for x in step if x[1] != target]
+        tracking = math.sqrt(sum(e * e for e in ramp) / len(ramp)) if ramp else None
+        yield target, max(0.0, overshoot), settled, tracking
+        previous = target
+
+
+def report(name, trace, profile):
+    print(name)
+    for target, overshoot, settled, tracking in step_metrics(trace, profile):
+        print('  %5.1fC  overshoot:%5.2fC  settled:%s%s' % (
+            target, overshoot, '%6.1fs' % settled if settled is not None else ' never',
+            '  ramp error:%5.2fC' % tracking if tracking is not None else ''))
+
+
+def simulate(build_dir):
+    global CONTROLLER
+    CONTROLLER = native_build.build(build_dir, 'pid_controller.cpp', ['src/vone/bed/heater/PidController.h'], cxx=args.cxx)
+
+    profile = [tuple(float(v) for v in (step + ':0').split(':')[:3]) for step in args.profile.split(',')]
+
+    kp, ki, kd = args.kp, args.ki, args.kd
+    if args.autotune:
+        random.seed(args.seed)
+        kp, ki, kd = autotune(args.autotune, args.cycles)
+        print('Autotune gains: M304 P%.2f I%.2f D%.2f' % (kp, ki, kd))
+
+    random.seed(args.seed)
+    report('Bang-bang', run(None, profile), profile)
+
+    random.seed(args.seed)
+    trace = run(Pid(kp, ki, kd, args.period), profile)
+    report('PID P%.2f I%.2f D%.2f' % (kp, ki, kd), trace, profile)
+
+    model = (args.model_a, args.model_b)
+    if args.identify:
+        random.seed(args.seed)
+        model = identify(args.identify, args.cooling)
+        print('Identified model: M306 A%.4f B%.6f' % model)
+    if model[0] > 0:
+        random.seed(args.seed)
+        trace = run(Pid(kp, ki, kd, args.period), profile, model)
+        report('PID P%.2f I%.2f D%.2f, model A%.4f B%.6f' % (kp, ki, kd, model[0], model[1]), trace, profile)
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(['time', 'setpoint', 'plate', 'sensor', 'output'])
+            writer.writerows(x[:5] for x in trace[::int(round(1 / DT))])
+
+
+if args.build_dir:
+    os.makedirs(args.build_dir, exist_ok=True)
+    simulate(args.build_dir)
+else:
+    with tempfile.TemporaryDirectory() as build_dir:
+        simulate(build_dir)
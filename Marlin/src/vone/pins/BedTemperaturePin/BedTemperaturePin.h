@@ -2,6 +2,7 @@
 
 #include "BedTemperaturePin.h"
 #include "ThermistorTable.h"
+#include "ThermistorLookupTable.h"
 #include "../adc/SamplingHelper.h"
 
 #include "../../../../Marlin.h"
@@ -13,12 +14,14 @@ class BedTemperaturePin {
   public:
     struct Sample {
       float temperature = 0;
+      long raw = 0;
       unsigned long startTime = 0;
       unsigned long endTime = 0;
 
       Sample() {}
       Sample(const adc::SampledValue& adcSample)
         : temperature(rawToTemperature(adcSample.value()))
+        , raw(adcSample.value())
         , startTime(adcSample.startTime)
         , endTime(adcSample.endTime)
       {
@@ -38,14 +41,18 @@ class BedTemperaturePin {
     // ADC sampling
     FORCE_INLINE void addAdcSample(unsigned long value);
 
+    // Conversions, see ThermistorLookupTable.h
+    // Note: raw values decrease as the temperature increases
+    static inline int16_t rawToFixedTemperature(long raw); // 1/THERMISTOR_LOOKUP_SCALE C
+    static inline float rawToTemperature(long raw);
+    static inline long temperatureToRaw(float celsius);
+
   private:
     int _analogPin;
 
     // ADC sampling
     const unsigned numSamples = NUM_SAMPLES_BED;
     adc::SamplingHelper adcSamples;
-
-    static inline float rawToTemperature(long raw);
 };
 
 
@@ -71,24 +78,54 @@ BedTemperaturePin::BedTemperaturePin(int analogPin)
 
 #define PGM_RD_W(x)   (short)pgm_read_word(&x)
 
-// DEFER: this code could be significantly clearer
-// could potentially move to utils too
+static const long s_maxRaw = long(THERMISTOR_LOOKUP_SIZE - 1) << THERMISTOR_LOOKUP_SHIFT;
+
+// The table is evenly spaced, so the entry is indexed by the raw value and
+// the interpolation is a multiply and a shift (no division, no floats)
+int16_t BedTemperaturePin::rawToFixedTemperature(long raw) {
+  if (raw <= 0) {
+    return PGM_RD_W(thermistorLookupTable[0]);
+  }
+  if (raw >= s_maxRaw) {
+    return PGM_RD_W(thermistorLookupTable[THERMISTOR_LOOKUP_SIZE - 1]);
+  }
+
+  const uint8_t index = raw >> THERMISTOR_LOOKUP_SHIFT;
+  const uint8_t fraction = raw & ((1 << THERMISTOR_LOOKUP_SHIFT) - 1);
+  const int16_t t0 = PGM_RD_W(thermistorLookupTable[index]);
+  const int16_t t1 = PGM_RD_W(thermistorLookupTable[index + 1]);
+  return t0 + (((t1 - t0) * fraction) >> THERMISTOR_LOOKUP_SHIFT);
+}
+
 float BedTemperaturePin::rawToTemperature(long raw) {
-  float celsius;
-  const auto size = sizeof(temperatureTable)/sizeof(*temperatureTable);
-  for (auto i = 1u; i < size; ++i) {
-    if (PGM_RD_W(temperatureTable[i][0]) > raw) {
-      celsius = (
-        PGM_RD_W(temperatureTable[i-1][1]) +
-          (raw - PGM_RD_W(temperatureTable[i-1][0])) *
-          (float)(PGM_RD_W(temperatureTable[i][1]) - PGM_RD_W(temperatureTable[i-1][1])) /
-          (float)(PGM_RD_W(temperatureTable[i][0]) - PGM_RD_W(temperatureTable[i-1][0]))
-      );
-      return celsius;
+  return rawToFixedTemperature(raw) * (1.0f / THERMISTOR_LOOKUP_SCALE);
+}
+
+// Binary search for the entries either side of the temperature, rounds
+// down (i.e. toward hotter), so raw > temperatureToRaw(t) means colder than t
+long BedTemperaturePin::temperatureToRaw(float celsius) {
+  const int16_t target = celsius * THERMISTOR_LOOKUP_SCALE;
+  uint8_t low = 0;
+  uint8_t high = THERMISTOR_LOOKUP_SIZE - 1;
+  if (target >= PGM_RD_W(thermistorLookupTable[low])) {
+    return 0;
+  }
+  if (target <= PGM_RD_W(thermistorLookupTable[high])) {
+    return s_maxRaw;
+  }
+
+  // Invariant: table[low] > target >= table[high]
+  while (high - low > 1) {
+    const uint8_t mid = (low + high) / 2;
+    if (PGM_RD_W(thermistorLookupTable[mid]) > target) {
+      low = mid;
+    } else {
+      high = mid;
     }
   }
 
-  // Overflow, use last value in table
-  celsius = PGM_RD_W(temperatureTable[size - 1][1]);
-  return celsius;
+  const int16_t t0 = PGM_RD_W(thermistorLookupTable[low]);
+  const int16_t t1 = PGM_RD_W(thermistorLookupTable[high]);
+  return (long(low) << THERMISTOR_LOOKUP_SHIFT) +
+    (long(t0 - target) << THERMISTOR_LOOKUP_SHIFT) / (t0 - t1);
 }
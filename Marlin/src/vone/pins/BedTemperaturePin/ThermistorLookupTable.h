@@ -0,0 +1,29 @@
+#pragma once
+
+// Generated by create_thermistor_lookuptable.py from ThermistorTable.h, do not edit
+// The temperature (in 1/THERMISTOR_LOOKUP_SCALE C) at every
+// 2^THERMISTOR_LOOKUP_SHIFT raw value, from 0 to 1024.
+// Max deviation from ThermistorTable.h: 0.50C (5 to 250C), 0.75C (5 to 300C)
+#define THERMISTOR_LOOKUP_SHIFT 3
+#define THERMISTOR_LOOKUP_SCALE 16
+#define THERMISTOR_LOOKUP_SIZE 129
+
+const int16_t thermistorLookupTable[THERMISTOR_LOOKUP_SIZE] PROGMEM = {
+   5850,  5610,  5370,  5130,  4890,  4650,  4410,  4200,
+   4032,  3904,  3776,  3672,  3576,  3488,  3408,  3336,
+   3264,  3200,  3144,  3088,  3035,  2987,  2939,  2896,
+   2853,  2811,  2768,  2732,  2698,  2662,  2627,  2594,
+   2560,  2531,  2502,  2473,  2444,  2415,  2387,  2362,
+   2337,  2312,  2287,  2262,  2237,  2216,  2194,  2173,
+   2151,  2130,  2108,  2087,  2065,  2044,  2022,  2001,
+   1979,  1958,  1936,  1915,  1896,  1878,  1859,  1840,
+   1821,  1802,  1784,  1765,  1746,  1728,  1710,  1691,
+   1673,  1655,  1637,  1618,  1600,  1582,  1563,  1545,
+   1527,  1509,  1490,  1472,  1454,  1435,  1416,  1398,
+   1379,  1360,  1341,  1321,  1302,  1282,  1263,  1243,
+   1221,  1201,  1181,  1160,  1137,  1115,  1093,  1071,
+   1047,  1024,   998,   973,   947,   921,   892,   864,
+    836,   804,   771,   737,   700,   660,   619,   576,
+    527,   475,   416,   352,   270,   173,    40,     0,
+      0,
+};
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+
+""" Generate the thermistor lookup table (ThermistorLookupTable.h).
+
+Evaluates ThermistorTable.h the way the firmware used to, i.e. linear
+interpolation between the entries (and extrapolation below the first), at
+evenly spaced raw values, so the firmware can index the table with the raw
+value and interpolate with a shift. Reports how far the generated table
+strays from ThermistorTable.h, which rounds to whole degrees itself.
+
+Usage: ./create_thermistor_lookuptable.py > ThermistorLookupTable.h
+"""
+
+import argparse
+import os
+import re
+import sys
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('-s', '--shift', type=int, default=3, help='raw values between entries, as a power of 2 (default=3, i.e. 8)')
+parser.add_argument('--scale', type=int, default=16, help='entries are in 1/scale C (default=16)')
+parser.add_argument('--adc-max', type=int, default=1024, help='raw value range (default=1024, i.e. 10-bit)')
+parser.add_argument('--source', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), 'ThermistorTable.h'))
+args = parser.parse_args()
+
+with open(args.source) as f:
+    source = f.read()
+body = source[source.index('temperatureTable'):]
+table = [(int(raw), int(celsius)) for raw, celsius in re.findall(r'\{\s*(-?\d+)\s*,\s*(-?\d+)\s*\}', body)]
+
+
+def to_temperature(raw):
+    """ See the previous BedTemperaturePin::rawToTemperature """
+    for (r0, t0), (r1, t1) in zip(table, table[1:]):
+        if r1 > raw:
+            return t0 + (raw - r0) * (t1 - t0) / (r1 - r0)
+    return float(table[-1][1])
+
+
+step = 1 << args.shift
+size = args.adc_max // step + 1
+lookup = [int(round(to_temperature(i * step) * args.scale)) for i in range(size)]
+if max(abs(v) for v in lookup) > 0x7fff or max(abs(a - b) for a, b in zip(lookup, lookup[1:])) * step > 0x7fff:
+    sys.exit('Entries are too large to interpolate in 16 bits, reduce the scale or shift')
+
+
+def from_lookup(raw):
+    """ See BedTemperaturePin::rawToFixedTemperature """
+    index = raw >> args.shift
+    if index >= size - 1:
+        return lookup[-1]
+    return lookup[index] + (((lookup[index + 1] - lookup[index]) * (raw & (step - 1))) >> args.shift)
+
+
+def deviation(low, high):
+    return max(
+        abs(from_lookup(raw) / args.scale - to_temperature(raw))
+        for raw in range(args.adc_max) if low <= to_temperature(raw) <= high
+    )
+
+
+in_use = deviation(5, 250)
+overall = deviation(5, 300)
+print('Max deviation from %s: %.2fC (5 to 250C), %.2fC (5 to 300C)' % (
+    os.path.basename(args.source), in_use, overall), file=sys.stderr)
+
+print('#pragma once')
+print()
+print('// Generated by create_thermistor_lookuptable.py from ThermistorTable.h, do not edit')
+print('// The temperature (in 1/THERMISTOR_LOOKUP_SCALE C) at every')
+print('// 2^THERMISTOR_LOOKUP_SHIFT raw value, from 0 to %d.' % args.adc_max)
+print('// Max deviation from ThermistorTable.h: %.2fC (5 to 250C), %.2fC (5 to 300C)' % (in_use, overall))
+print('#define THERMISTOR_LOOKUP_SHIFT %d' % args.shift)
+print('#define THERMISTOR_LOOKUP_SCALE %d' % args.scale)
+print('#define THERMISTOR_LOOKUP_SIZE %d' % size)
+print()
+print('const int16_t thermistorLookupTable[THERMISTOR_LOOKUP_SIZE] PROGMEM = {')
+for i in range(0, size, 8):
+    print('  ' + ' '.join('%5d,' % v for v in lookup[i:i + 8]))
+print('};')
@@ -7,6 +7,7 @@
 #include "../../../planner.h"
 #include "../../../stepper.h"
 #include "../../../serial.h"
+#include "../../api/movement/movement.h"
 #include "./digipots.h"
 #include "./trinamicMotors.h"
 
@@ -72,6 +73,8 @@ Stepper::Stepper(
   // frequency on a 16MHz MCU. If you are going to change this, be
   // sure to regenerate speed_lookuptable.h with
   // create_speed_lookuptable.py
+  // Note: the stepper isr switches to a divider of 64 for very slow
+  //       moves (see SLOW_STEP_RATE in stepper.cpp)
   TCCR1B = (TCCR1B & ~(0x07<<CS10)) | (2<<CS10);
 
   OCR1A = 0x4000;
@@ -82,10 +85,14 @@ void Stepper::start() {
   st_start();
 }
 
-void Stepper::stop(const __FlashStringHelper* reason) {
+void Stepper::stop(const __FlashStringHelper* reason, bool decelerate) {
   ScopedInterruptDisable sid;
   m_stopReason = reason;
-  quickStop();
+  if (decelerate) {
+    decelerateToStop();
+  } else {
+    quickStop();
+  }
 }
 
 void Stepper::resume() {
@@ -188,6 +195,34 @@ int Stepper::add(float x, float y, float z, float e, float f) {
   return 0;
 }
 
+int Stepper::babystepZ(float mm) {
+  const auto rejectReason = stopReason();
+  if (rejectReason) {
+    logError
+      << F("Unable to babystep, ")
+      << rejectReason
+      << endl;
+    return -1;
+  }
+
+  const auto offset = babystepOffsetZ() + mm;
+  if (fabs(offset) > BABYSTEP_MAX_Z_OFFSET) {
+    logError
+      << F("Unable to babystep, total adjustment of ") << offset
+      << F("mm would exceed the limit of ") << BABYSTEP_MAX_Z_OFFSET
+      << F("mm")
+      << endl;
+    return -1;
+  }
+
+  st_babystep_z(millimetersToSteps(mm, Z_AXIS));
+  return 0;
+}
+
+float Stepper::babystepOffsetZ() const {
+  return stepsToMillimeters(st_get_babysteps_z(), Z_AXIS);
+}
+
 void Stepper::outputStatus() {
   maxStepsComplete.outputStatus();
   maxInterruptsAllowed.outputStatus();
@@ -15,7 +15,10 @@ class Stepper {
     EndstopMonitor& endstopMonitor;
 
     bool stopped() const;
-    void stop(const __FlashStringHelper* reason);
+    // Stop, discarding any queued moves
+    // Note: decelerating prevents lost steps, so the planner can be resync'd
+    //       with the step counts (see resyncWithStepCount), once stopped
+    void stop(const __FlashStringHelper* reason, bool decelerate = false);
     void resume();
 
     void enableSkewAdjustment(bool enable = true);
@@ -32,6 +35,12 @@ class Stepper {
 
     int add(float x, float y, float z, float e, float f);
 
+    // Babystepping -- adjust z without waiting for queued moves to finish
+    // NOTE: the planner is not aware of babysteps, so its position will differ
+    //       from the step count by babystepOffsetZ()
+    int babystepZ(float mm);
+    float babystepOffsetZ() const;
+
     void finishPendingMoves() const;
 
     // DEFER: Ideally the stepper isr would be defined in this file
@@ -0,0 +1,60 @@
+#include "StepperTrace.h"
+
+#if ENABLED(STEPPER_TRACE)
+
+#include "../../../serial.h"
+
+namespace stepperTrace {
+  Event events[STEPPER_TRACE_SIZE];
+  volatile uint16_t head = 0;
+  volatile uint16_t count = 0;
+  volatile bool paused = false;
+
+  static const uint8_t EventsPerLine = 16;
+
+  static void s_writeHex(uint8_t value) {
+    static const char digits[] = "0123456789abcdef";
+    MYSERIAL.write(digits[value >> 4]);
+    MYSERIAL.write(digits[value & 0x0f]);
+  }
+
+  int dump() {
+    // Stop recording, so events are not overwritten while we output them
+    // Note: the isr does not change head or count once paused
+    paused = true;
+    const uint16_t total = count;
+    const uint16_t start = (head - total) & (STEPPER_TRACE_SIZE - 1);
+
+    // Note: the trace is sent as text (not as a log), so that it can not be
+    //       dropped if the transmit buffer fills, and is hex encoded, so that
+    //       it can not be mistaken for framing or realtime command bytes
+    MYSERIAL
+      << F("stepperTrace")
+      << F(" events:") << total
+      << F(" bytes:") << total * sizeof(Event)
+      << endl;
+
+    for (auto i = 0u; i < total; ++i) {
+      if (i % EventsPerLine == 0) {
+        if (i != 0) {
+          MYSERIAL << endl;
+        }
+        MYSERIAL << F("stepperTrace: ");
+      }
+      const auto bytes = reinterpret_cast<const uint8_t*>(&events[(start + i) & (STEPPER_TRACE_SIZE - 1)]);
+      for (auto j = 0u; j < sizeof(Event); ++j) {
+        s_writeHex(bytes[j]);
+      }
+    }
+    if (total) {
+      MYSERIAL << endl;
+    }
+
+    head = 0;
+    count = 0;
+    paused = false;
+    return 0;
+  }
+}
+
+#endif
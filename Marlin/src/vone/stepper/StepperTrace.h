@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../../../MarlinConfig.h"
+
+// Stepper event trace
+// Records each call of the stepper isr (the timer interval it scheduled, the
+// steps it took, the block it is executing and the acceleration phase) in a
+// ring buffer, so that the step timing the isr actually produces can be
+// analyzed. The buffer is output, hex encoded, using D6. Use
+// decode_stepper_trace.py to convert the output to velocity vs time.
+//
+// Enable with STEPPER_TRACE (see Configuration.h). When disabled, recording
+// compiles to nothing.
+#if ENABLED(STEPPER_TRACE)
+
+#if !IS_POWER_OF_2(STEPPER_TRACE_SIZE)
+  #error "STEPPER_TRACE_SIZE must be a power of 2"
+#endif
+
+namespace stepperTrace {
+  enum Phase {
+    Idle = 0,
+    Accelerating = 1,
+    Cruising = 2,
+    Decelerating = 3
+  };
+
+  // Note: 4 bytes, output as-is (little-endian), hex encoded
+  struct Event {
+    uint16_t timer;      // timer tics until the next isr call
+    uint8_t steps;       // step events taken in this isr call
+    uint8_t blockPhase;  // for the scheduled interval: slow prescaler (bit 7), block index (bits 2-6)
+                         // and acceleration phase (bits 0-1)
+  };
+
+  extern Event events[STEPPER_TRACE_SIZE];
+  extern volatile uint16_t head;
+  extern volatile uint16_t count;
+  extern volatile bool paused;
+
+  // Note: only call from the stepper isr
+  FORCE_INLINE void record(uint16_t timer, bool slowPrescaler, uint8_t steps, uint8_t blockIndex, Phase phase) {
+    if (paused || (phase == Idle && steps == 0)) {
+      return;
+    }
+
+    auto& event = events[head];
+    event.timer = timer;
+    event.steps = steps;
+    event.blockPhase = (slowPrescaler ? 0x80 : 0) | (blockIndex << 2) | phase;
+
+    head = (head + 1) & (STEPPER_TRACE_SIZE - 1);
+    if (count < STEPPER_TRACE_SIZE) {
+      ++count;
+    }
+  }
+
+  // Output the recorded events (oldest first) and clear the buffer
+  int dump();
+}
+
+#define STEPPER_TRACE_RECORD(timer, slowPrescaler, steps, blockIndex, phase) \
+  stepperTrace::record(timer, slowPrescaler, steps, blockIndex, phase)
+
+#else
+
+#define STEPPER_TRACE_RECORD(timer, slowPrescaler, steps, blockIndex, phase)
+
+#endif
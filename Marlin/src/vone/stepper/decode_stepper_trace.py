@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+
+""" Decode the stepper trace output by D6 (see StepperTrace.h).
+
+Reads a capture of the serial output (e.g. saved by a terminal program) and
+writes a CSV of time vs velocity, optionally plotting it.
+"""
+
+import argparse
+import csv
+import re
+import struct
+import sys
+
+PHASES = ['idle', 'accelerating', 'cruising', 'decelerating']
+HEADER = re.compile(r'stepperTrace events:(\d+) bytes:(\d+)\r?\n')
+LINE = re.compile(r'stepperTrace: ([0-9a-f]*)')
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('capture', help='file containing the serial output of D6')
+parser.add_argument('-o', '--output', help='csv file to write (default=stdout)')
+parser.add_argument('-f', '--timer-freq', type=int, default=2000000, help='stepper timer frequency in Hz (default=2000000)')
+parser.add_argument('-s', '--slow-timer-freq', type=int, default=250000, help='stepper timer frequency for slow blocks in Hz (default=250000)')
+parser.add_argument('-p', '--plot', action='store_true', help='plot velocity vs time (requires matplotlib)')
+args = parser.parse_args()
+
+data = open(args.capture, errors='replace').read()
+match = HEADER.search(data)
+if not match:
+    sys.exit('No stepper trace found in ' + args.capture)
+
+count, size = int(match.group(1)), int(match.group(2))
+payload = bytes.fromhex(''.join(LINE.findall(data, match.end())))[:size]
+if len(payload) != size:
+    sys.exit('Stepper trace is truncated, expected %d bytes, found %d' % (size, len(payload)))
+
+# Note: the steps recorded in an event were taken at the end of the interval
+#       scheduled by the previous event
+rows = []
+time = 0.0
+previous_interval = None
+for timer, steps, block_phase in struct.iter_unpack('<HBB', payload):
+    slow = block_phase & 0x80
+    interval = timer / float(args.slow_timer_freq if slow else args.timer_freq)
+    rows.append({
+        'time': time,
+        'interval': interval,
+        'steps': steps,
+        'velocity': steps / previous_interval if previous_interval else 0,
+        'block': (block_phase >> 2) & 0x1f,
+        'phase': PHASES[block_phase & 0x03],
+    })
+    time += interval
+    previous_interval = interval
+
+out = open(args.output, 'w', newline='') if args.output else sys.stdout
+writer = csv.DictWriter(out, fieldnames=['time', 'interval', 'steps', 'velocity', 'block', 'phase'])
+writer.writeheader()
+writer.writerows(rows)
+
+if args.plot:
+    import matplotlib.pyplot as plt
+    plt.step([r['time'] for r in rows], [r['velocity'] for r in rows], where='post')
+    plt.xlabel('time (s)')
+    plt.ylabel('velocity (steps/s)')
+    plt.title('Stepper trace, %d events' % count)
+    plt.show()
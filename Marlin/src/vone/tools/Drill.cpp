@@ -5,27 +5,14 @@
 #include "../../../stepper.h"
 #include "../../api/api.h"
 #include "../../vone/pins/PTopPin/PTopPin.h"
-
-static uint8_t CRC8(uint8_t data) {
-  uint8_t crc = 0x00;
-  uint8_t extract = data;
-  for (uint8_t tempI = 8; tempI; tempI--) {
-    uint8_t sum = (crc ^ extract) & 0x01;
-    crc >>= 1;
-    if (sum) {
-      crc ^= 0x8C;
-    }
-    extract>>=1;
-  }
-  return crc;
-}
+#include "../../utils/crc8.h"
 
 static int s_sendAndRampTo(PTopPin& pin, int percent) {
   log << F("Set drill rotation speed to ") << percent << endl;
 
   // Format message
   char message[11];
-  const int crc = CRC8(percent);
+  const int crc = crc8_update(0, percent);
   sprintf(message, "R%u %u", percent, crc);
 
   // Send
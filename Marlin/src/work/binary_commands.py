@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+
+""" Encode binary commands (see commands/binaryCommand.h).
+
+Can be imported (e.g. by windowed_host.py), or run to print the frame for a
+command, e.g.
+
+  binary_commands.py 12 "G1 X10.5 Y-3 F3000"
+"""
+
+import struct
+
+MOVE = 0x01
+MOVE_FEEDRATE = 0x10
+AXES = 'XYZE'
+
+
+def crc16(data):
+    """ CRC-16/CCITT-FALSE, see utils/crc16.h """
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    """ Consistent Overhead Byte Stuffing, see utils/cobs.h """
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(byte)
+            if len(block) == 254:
+                out += b'\xff' + block
+                block = bytearray()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out)
+
+
+def frame(opcode, line_number, payload):
+    data = struct.pack('<BH', opcode, line_number) + payload
+    data += struct.pack('<H', crc16(data))
+    return b'\x00' + cobs_encode(data) + b'\x00'
+
+
+def move(line_number, x=None, y=None, z=None, e=None, f=None):
+    """ A move (same as G1), positions in mm and feedrate in mm/min """
+    axes = 0
+    payload = b''
+    for i, value in enumerate((x, y, z, e)):
+        if value is not None:
+            axes |= 1 << i
+            payload += struct.pack('<i', int(round(value * 1000)))
+    if f is not None:
+        axes |= MOVE_FEEDRATE
+        payload += struct.pack('<H', int(round(f)))
+    return frame(MOVE, line_number, bytes([axes]) + payload)
+
+
+def encode(line_number, command):
+    """ Encode a text command as a binary command, returns None if there is no equivalent """
+    fields = command.split()
+    if not fields or fields[0] not in ('G0', 'G1'):
+        return None
+
+    args = {}
+    for field in fields[1:]:
+        letter = field[0].lower()
+        if letter not in 'xyzef' or letter in args:
+            return None
+        try:
+            args[letter] = float(field[1:])
+        except ValueError:
+            return None
+
+    if 'f' in args and not 0 < args['f'] <= 0xFFFF:
+        return None
+    return move(line_number, **args)
+
+
+if __name__ == '__main__':
+    import argparse
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('line_number', type=int)
+    parser.add_argument('command')
+    args = parser.parse_args()
+
+    data = encode(args.line_number, args.command)
+    if data is None:
+        parser.exit(1, 'No binary equivalent for "%s"\n' % args.command)
+    print(data.hex())
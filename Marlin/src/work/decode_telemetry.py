@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+
+""" Decode the binary telemetry output after M131 (see telemetry.cpp).
+
+Reads a capture of the serial output, or a serial port (requires pyserial),
+and writes a CSV of the telemetry frames. Text output and compact log records
+are ignored.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('input', help='file containing the serial output, or a serial port (with --port)')
+parser.add_argument('-p', '--port', action='store_true', help='read from a serial port, until interrupted')
+parser.add_argument('-b', '--baud', type=int, default=250000, help='baud rate (default=250000)')
+parser.add_argument('-o', '--output', help='csv file to write (default=stdout)')
+args = parser.parse_args()
+
+TELEMETRY_FRAME = 0x80
+FRAME = struct.Struct('<BBI4ihhBBBH')
+FIELDS = [
+    'sequence', 'time', 'x_steps', 'y_steps', 'z_steps', 'e_steps',
+    'temperature', 'target', 'heater_on', 'stepper_stopped', 'feed_held',
+    'planned_moves', 'block', 'skipped',
+]
+
+
+def crc16(data):
+    """ CRC-16/CCITT-FALSE, see utils/crc16.h """
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """ See utils/cobs.h, returns None if the data is not valid """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frames(chunks):
+    """ Yields the (decoded) frames, which are delimited by zeros """
+    pending = bytearray()
+    in_frame = False
+    for chunk in chunks:
+        for byte in chunk:
+            if byte != 0:
+                pending.append(byte)
+            elif in_frame and pending:
+                frame = cobs_decode(pending)
+                if frame:
+                    yield frame
+                in_frame = False
+                pending.clear()
+            else:
+                # Note: a zero after an empty frame starts a frame (i.e. resyncs)
+                in_frame = True
+                pending.clear()
+
+
+def decode(chunks, writer):
+    previous = None
+    corrupt = 0
+    for frame in frames(chunks):
+        if frame[0] != TELEMETRY_FRAME:
+            continue
+        if len(frame) != FRAME.size or crc16(frame[:-2]) != struct.unpack('<H', frame[-2:])[0]:
+            corrupt += 1
+            continue
+
+        _, sequence, time, x, y, z, e, temperature, target, flags, planned, block, _ = FRAME.unpack(frame)
+        writer.writerow({
+            'sequence': sequence,
+            'time': time / 1000.0,
+            'x_steps': x,
+            'y_steps': y,
+            'z_steps': z,
+            'e_steps': e,
+            'temperature': temperature / 10.0,
+            'target': target / 10.0,
+            'heater_on': int(bool(flags & 0x01)),
+            'stepper_stopped': int(bool(flags & 0x02)),
+            'feed_held': int(bool(flags & 0x04)),
+            'planned_moves': planned,
+            'block': block,
+            # Frames skipped by the firmware (i.e. the transmit buffer was full), or lost
+            'skipped': (sequence - previous - 1) & 0xFF if previous is not None else 0,
+        })
+        previous = sequence
+    if corrupt:
+        print('Ignored %d corrupt frames' % corrupt, file=sys.stderr)
+
+
+def read_port():
+    import serial
+    port = serial.Serial(args.input, args.baud, timeout=0.1)
+    while True:
+        yield port.read(port.in_waiting or 1)
+
+
+out = open(args.output, 'w', newline='') if args.output else sys.stdout
+writer = csv.DictWriter(out, fieldnames=FIELDS)
+writer.writeheader()
+try:
+    decode(read_port() if args.port else [open(args.input, 'rb').read()], writer)
+except KeyboardInterrupt:
+    pass
@@ -1,10 +1,175 @@
 #include "../../serial.h"
 #include "../commands/processing.h"
+#include "../commands/AckPolicy.h"
 #include "work.h"
 #include "../utils/crc8.h"
+#include "../utils/crc16.h"
+#include "../utils/cobs.h"
+#include "../utils/parseNumber.h"
+#include "../commands/binaryCommand.h"
 
 static int s_bufferIndex = 0;
 
+// The checksum of the command being received, computed as characters arrive
+// Note: covers the characters from the first non-space up to the '*'
+enum class ChecksumState : uint8_t { LeadingSpaces, Summing, Done };
+static ChecksumState s_checksumState = ChecksumState::LeadingSpaces;
+static uint8_t s_checksum = 0;
+
+static void s_updateChecksum(char ch) {
+  switch (s_checksumState) {
+    case ChecksumState::LeadingSpaces:
+      if (ch == ' ') {
+        return;
+      }
+      s_checksumState = ChecksumState::Summing;
+      // fall through
+
+    case ChecksumState::Summing:
+      if (ch == '*') {
+        s_checksumState = ChecksumState::Done;
+      } else {
+        s_checksum = crc8_update(s_checksum, ch);
+      }
+      return;
+
+    case ChecksumState::Done:
+      return;
+  }
+}
+
+// Prepare to receive the next command
+static void s_resetCommand() {
+  s_bufferIndex = 0;
+  s_checksumState = ChecksumState::LeadingSpaces;
+  s_checksum = 0;
+}
+#if ENABLED(BINARY_COMMANDS)
+static bool s_inFrame = false; // receiving a binary frame (see binaryCommand.h)
+#endif
+static uint16_t s_expectedLineNumber = 1;
+
+// Windowed protocol
+// By default, the host waits for the ok of each command before sending the
+// next one. When the windowed protocol is enabled (M130 W1) the host may keep
+// up to BUFSIZE numbered lines in flight, so the link does not idle while a
+// command is processed. To support this
+//   - each ok includes the line number it acknowledges and the number of free
+//     command queue slots (i.e. MAX_CMD_SIZE commands that are sure to fit in
+//     the remaining bytes), e.g. "ok N12 B3"
+//   - errors output while a command is processed are tagged with its line
+//     number, e.g. "error: N12 Unable to ...", since they can follow its ok
+//     (see AckPolicy.h)
+//   - errors are recovered go-back-N style, i.e. we request a resend of the
+//     expected line and then discard the lines that were already in flight
+//     (without requesting more resends), until the expected line arrives.
+//     A line that is discarded does not consume a line number.
+//   - if the resent line is lost too, the host's next resent line is numbered
+//     at or below a line already discarded, so the resend is requested again
+//     (rather than waiting for the host to time out)
+// Note: if every resent line is lost, the host is expected to time out and
+//       resend its unacknowledged lines.
+// See windowed_host.py, for a reference implementation of the host side.
+static bool s_windowed = false;
+static bool s_discardingInFlight = false;
+static uint16_t s_lastAcknowledged = 0; // the line number of the last ok sent
+
+// The highest line number discarded since the resend was requested
+// Note: the number of an invalid line is not known (e.g. it may be corrupt)
+static const long UnknownLineNumber = -1;
+static long s_highestDiscarded = UnknownLineNumber;
+
+void setWindowedProtocol(bool enable) {
+  s_windowed = enable;
+  logging::priorityResponses = enable;
+  s_discardingInFlight = false;
+}
+
+bool windowedProtocol() {
+  return s_windowed;
+}
+
+#if ENABLED(PROTOCOL_STATS)
+// Protocol statistics (see D7)
+// Ack latency is the time from receiving a command to sending its ok, as a
+// histogram with buckets of <1, <4, <16, <64, <256, <1024 and >=1024 ms
+// Note: latencies are measured with 16-bit timestamps, so they must be
+//       less than 65s
+static const uint8_t LatencyBuckets = 7;
+static struct {
+  unsigned long since;
+  unsigned long accepted;
+  unsigned long binary;
+  unsigned long resends;
+  unsigned long discarded;    // lines in flight, discarded after a resend request
+  unsigned long tooLong;
+  unsigned long ackLatency[LatencyBuckets];
+  uint16_t maxAckLatency;
+  #if TX_PRIORITY_BUFFER_SIZE > 0
+    // Responses sent ahead of queued output (see MarlinSerial), when reset
+    uint32_t preemptedAtReset;
+    uint32_t preemptedBytesAtReset;
+  #endif
+} s_stats;
+
+static void s_recordAckLatency(uint16_t receivedAt) {
+  const uint16_t latency = uint16_t(millis()) - receivedAt;
+  uint8_t bucket = 0;
+  for (uint16_t limit = 1; bucket < LatencyBuckets - 1 && latency >= limit; limit *= 4) {
+    ++bucket;
+  }
+  ++s_stats.ackLatency[bucket];
+  NOLESS(s_stats.maxAckLatency, latency);
+}
+
+void resetProtocolStats() {
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_stats.since = millis();
+  #if TX_PRIORITY_BUFFER_SIZE > 0
+    s_stats.preemptedAtReset = MYSERIAL.txPreempted();
+    s_stats.preemptedBytesAtReset = MYSERIAL.txPreemptedBytes();
+  #endif
+}
+
+void outputProtocolStats() {
+  const auto seconds = (millis() - s_stats.since) / 1000.0f;
+  log
+    << F("Protocol stats: seconds:") << FloatWithFormat(seconds, 1)
+    << F(" commands:") << s_stats.accepted
+    << F(" commandsPerSecond:") << FloatWithFormat(seconds > 0 ? s_stats.accepted / seconds : 0, 1)
+    << F(" binary:") << s_stats.binary
+    << F(" resends:") << s_stats.resends
+    << F(" discarded:") << s_stats.discarded
+    << F(" tooLong:") << s_stats.tooLong
+    << endl;
+  log
+    << F("Ack latency (ms): <1:") << s_stats.ackLatency[0]
+    << F(" <4:") << s_stats.ackLatency[1]
+    << F(" <16:") << s_stats.ackLatency[2]
+    << F(" <64:") << s_stats.ackLatency[3]
+    << F(" <256:") << s_stats.ackLatency[4]
+    << F(" <1024:") << s_stats.ackLatency[5]
+    << F(" >=1024:") << s_stats.ackLatency[6]
+    << F(" max:") << s_stats.maxAckLatency
+    << endl;
+
+  #if TX_PRIORITY_BUFFER_SIZE > 0
+    // The latency saved is the time to send the output the responses went
+    // ahead of (10 bits per byte), an upper bound since the rest of the line
+    // being sent is not overtaken
+    const uint32_t preempted = MYSERIAL.txPreempted() - s_stats.preemptedAtReset;
+    const uint32_t preemptedBytes = MYSERIAL.txPreemptedBytes() - s_stats.preemptedBytesAtReset;
+    const float savedMs = preemptedBytes * 10000.0f / BAUDRATE;
+    log
+      << F("Priority responses: sentEarly:") << preempted
+      << F(" bytesOvertaken:") << preemptedBytes
+      << F(" latencySavedMs:") << FloatWithFormat(savedMs, 1)
+      << F(" perResponseMs:") << FloatWithFormat(preempted ? savedMs / preempted : 0, 2)
+      << endl;
+  #endif
+}
+#endif
+
 inline const char* skipWhitespace(const char* ptr) {
   while (*ptr == ' ') {
     ++ptr;
@@ -15,8 +180,28 @@ inline const char* skipWhitespace(const char* ptr) {
 static void s_requestResend(
   unsigned long expectedLineNumber,
   const __FlashStringHelper* pgmReason,
-  const char* msg
+  const char* msg,
+  long lineNumber = UnknownLineNumber
 ) {
+  if (s_windowed) {
+    // Discard the lines in flight, unless the host has started resending
+    if (s_discardingInFlight && (lineNumber == UnknownLineNumber || lineNumber > s_highestDiscarded)) {
+      if (lineNumber != UnknownLineNumber) {
+        s_highestDiscarded = lineNumber;
+      }
+      #if ENABLED(PROTOCOL_STATS)
+        ++s_stats.discarded;
+      #endif
+      return;
+    }
+    s_discardingInFlight = true;
+    s_highestDiscarded = lineNumber;
+  }
+
+  #if ENABLED(PROTOCOL_STATS)
+    ++s_stats.resends;
+  #endif
+
   protocol
     << F("Resend lineNumber:") << expectedLineNumber
     << F(", reason:\"") << pgmReason
@@ -25,14 +210,23 @@ static void s_requestResend(
     << endl;
 }
 
-void s_sendResponseOk() {
-  protocol << F("ok") << endl;
+static void s_sendResponseOk(uint16_t lineNumber) {
+  s_lastAcknowledged = lineNumber;
+  if (s_windowed) {
+    protocol
+      << F("ok N") << lineNumber
+      << F(" B") << command_queue.freeSlots()
+      << endl;
+  } else {
+    protocol << F("ok") << endl;
+  }
 }
 
 inline const char* parse(
   const char* msg,
   unsigned int len,
-  unsigned int expectedLineNumber
+  unsigned int expectedLineNumber,
+  uint8_t computedChecksum
 ) {
   // skip empty lines
   if (len == 0) {
@@ -83,7 +277,7 @@ inline const char* parse(
     fnRequestResend(F("Missing message length"));
     return nullptr;
   }
-  const auto expectedLength = strtol(comma + 1, nullptr, 10);
+  const auto expectedLength = parseLong(comma + 1);
   const auto actuallength = (comma - msg);
   if (expectedLength != actuallength) {
     // Log the expected vs actual lengths (for debugging)
@@ -105,7 +299,6 @@ inline const char* parse(
     return nullptr;
   }
   const auto msgChecksum = strtol(star + 1, nullptr, 16);
-  const auto computedChecksum = crc8(commandStart, star - msg);
   if (msgChecksum != computedChecksum) {
     fnRequestResend(F("Bad checksum"));
     return nullptr;
@@ -117,13 +310,13 @@ inline const char* parse(
   //       much more likely to point to the client and printer falling
   //       out of sync.
   const char* newCommandStart = nullptr;
-  const auto lineNumber = strtol(commandStart + 1, const_cast<char**>(&newCommandStart), 10);
+  const auto lineNumber = parseLong(commandStart + 1, &newCommandStart);
   if (*commandStart != lineNumberChar) {
     fnRequestResend(F("Missing line number"));
     return nullptr;
   }
   if (lineNumber != expectedLineNumber) {
-    fnRequestResend(F("Line number does not match expected value"));
+    s_requestResend(expectedLineNumber, F("Line number does not match expected value"), msg, lineNumber);
     return nullptr;
   }
 
@@ -131,45 +324,289 @@ inline const char* parse(
   return skipWhitespace(newCommandStart);
 }
 
-static uint16_t s_expectedLineNumber = 1;
+// Note: we increment the expected line number if we
+//       - send an ok now
+//       - accept the command (and will send an ok later)
+//       - request re-send (unless using the windowed protocol)
+// TODO: smells weird, should eliminate command queue
+static void s_acceptCommand(const char* command) {
+  // Acknowledge now, if the command allows it
+  // Note: only if all commands ahead of it have been acknowledged,
+  //       so that acks are sent in the order commands were received
+  // Note: only with the windowed protocol, otherwise the host expects
+  //       a command's errors before its ok (see AckPolicy.h)
+  const bool acknowledge = (
+    s_windowed &&
+    command_queue.allAcknowledged() &&
+    ackPolicy(command) == AckPolicy::OnReceipt
+  );
+  command_queue.push(command, s_expectedLineNumber, acknowledge);
+  if (acknowledge) {
+    s_sendResponseOk(s_expectedLineNumber);
+  }
+
+  #if ENABLED(PROTOCOL_STATS)
+    ++s_stats.accepted;
+    if (binaryCommand::isBinary(command)) {
+      ++s_stats.binary;
+    }
+    if (acknowledge) {
+      s_recordAckLatency(millis());
+    }
+  #endif
+  s_discardingInFlight = false;
+  ++s_expectedLineNumber;
+}
+
+static void s_rejectCommand() {
+  if (!s_windowed) {
+    ++s_expectedLineNumber;
+  }
+}
+
+static void s_ignoreLongCommand() {
+  // Note: if discarding in-flight lines, this line will be resent
+  if (!s_discardingInFlight) {
+    s_sendResponseOk(s_expectedLineNumber);
+    ++s_expectedLineNumber;
+  }
+
+  #if ENABLED(PROTOCOL_STATS)
+    ++s_stats.tooLong;
+  #endif
+}
+
+#if ENABLED(BINARY_COMMANDS)
+// Validates a binary frame (see binaryCommand.h), which is decoded in place
+// and rearranged into the form stored in the command queue
+inline const char* parseFrame(
+  uint8_t* frame,
+  unsigned int len,
+  unsigned int expectedLineNumber
+) {
+  const auto fnRequestResend = [expectedLineNumber](const __FlashStringHelper* pgmReason) {
+    s_requestResend(expectedLineNumber, pgmReason, "<binary>");
+  };
+
+  const auto size = cobsDecode(frame, len, frame);
+  if (size < binaryCommand::MinimumFrameSize) {
+    fnRequestResend(F("Bad frame"));
+    return nullptr;
+  }
+
+  // Validate the checksum
+  const uint16_t msgChecksum = frame[size - 2] | (frame[size - 1] << 8);
+  if (msgChecksum != crc16(frame, size - 2)) {
+    fnRequestResend(F("Bad checksum"));
+    return nullptr;
+  }
+
+  // Check line number
+  const uint16_t lineNumber = frame[1] | (frame[2] << 8);
+  if (lineNumber != expectedLineNumber) {
+    s_requestResend(expectedLineNumber, F("Line number does not match expected value"), "<binary>", lineNumber);
+    return nullptr;
+  }
+
+  // Replace the line number with the marker and size, i.e.
+  //   opcode, line number, payload => marker, size, opcode, payload
+  frame[2] = frame[0];
+  frame[1] = size - 4; // opcode and payload
+  frame[0] = binaryCommand::Marker;
+  return reinterpret_cast<const char*>(frame);
+}
+#endif
+
+// Flushing
+// Discards received bytes until the line is idle for FlushIdleMs, or a
+// resync marker (CAN) is received between frames, then requests a resend.
+// This is done by the main loop, so other work continues while commands are
+// flushed. The ok of the command that started the flush is deferred until
+// the flush finishes, so the host does not send a line that would be discarded.
+// Note: There is a race between the app and the flush, the app may be about
+//       to send (or have sent) commands that are still in transit. The idle
+//       period gives those time to arrive, so they are discarded too. An app
+//       that knows it is done sending can send the resync marker to skip the wait.
+static const unsigned long FlushIdleMs = 50;
+static const char FlushResyncMarker = 0x18;
+static bool s_flushing = false;
+static unsigned long s_flushIdleSince = 0;
+static unsigned long s_flushedBytes = 0;
+
+static struct {
+  bool pending;
+  uint16_t lineNumber;
+  #if ENABLED(PROTOCOL_STATS)
+    uint16_t receivedAt;
+  #endif
+} s_deferredOk;
+
+static void s_sendDeferredOk() {
+  if (s_deferredOk.pending) {
+    s_deferredOk.pending = false;
+    s_sendResponseOk(s_deferredOk.lineNumber);
+    #if ENABLED(PROTOCOL_STATS)
+      s_recordAckLatency(s_deferredOk.receivedAt);
+    #endif
+  }
+}
+
+static void s_finishFlush() {
+  s_flushing = false;
+  s_resetCommand();
+  log << F("Flushed ") << s_flushedBytes << F(" bytes") << endl;
+
+  if (s_windowed) {
+    // Resume after the last line acknowledged
+    // Note: queued commands that were acknowledged on receipt were discarded
+    //       too, but are not resent, the host has been sent the error that
+    //       started the flush. Unacknowledged lines are resent.
+    s_sendDeferredOk();
+    s_expectedLineNumber = s_lastAcknowledged + 1;
+
+    // Always request a resend, the host may have lines in flight
+    s_discardingInFlight = false;
+    s_requestResend(
+      s_expectedLineNumber,
+      F("Flushed serial buffer"),
+      "<unknown>"
+    );
+  } else {
+    if (s_flushedBytes > 0) {
+      s_requestResend(
+        s_expectedLineNumber,
+        F("Flushed serial buffer"),
+        "<unknown>"
+      );
+      ++s_expectedLineNumber;
+    }
+    s_sendDeferredOk();
+  }
+}
+
+// Returns true while flushing
+static bool s_continueFlush() {
+  if (!s_flushing) {
+    return false;
+  }
+
+  const auto now = millis();
+  int value;
+  while ((value = MYSERIAL.read()) != -1) {
+    s_flushIdleSince = now;
+
+#if ENABLED(BINARY_COMMANDS)
+    // Follow the frames being discarded, the marker may be part of a frame
+    // Note: like read_commands(), an empty frame is a start delimiter, only
+    //       whether the frame is empty is kept (in s_bufferIndex)
+    if (value == 0 || s_inFrame) {
+      if (value == 0) {
+        s_inFrame = !s_inFrame || s_bufferIndex == 0;
+        s_bufferIndex = 0;
+      } else {
+        s_bufferIndex = 1;
+      }
+      ++s_flushedBytes;
+      continue;
+    }
+#endif
+
+    if (value == FlushResyncMarker) {
+      s_finishFlush();
+      return false;
+    }
+    ++s_flushedBytes;
+  }
+
+  if (now - s_flushIdleSince >= FlushIdleMs) {
+    s_finishFlush();
+    return false;
+  }
+  return true;
+}
+
 static void read_commands() {
   static char s_buffer[MAX_CMD_SIZE];
   static auto s_tooLong = false;
 
+  if (s_continueFlush()) {
+    return;
+  }
+
   while (!command_queue.full()) {
-    char ch = MYSERIAL.read();
+    // Note: check for -1 before converting, a binary frame may contain 0xFF
+    const int value = MYSERIAL.read();
 
     // No characters available
-    if (ch == -1) {
+    if (value == -1) {
       break;
+    }
+    const char ch = value;
+
+#if ENABLED(BINARY_COMMANDS)
+    // Frame delimiter, starts or ends a binary frame
+    if (ch == 0) {
+      if (s_inFrame && (s_bufferIndex > 0 || s_tooLong)) {
+        if (s_tooLong) {
+          s_ignoreLongCommand();
+        } else {
+          const char* command = parseFrame(reinterpret_cast<uint8_t*>(s_buffer), s_bufferIndex, s_expectedLineNumber);
+          if (command) {
+            s_acceptCommand(command);
+          } else {
+            s_rejectCommand();
+          }
+        }
+        s_inFrame = false;
+      } else if (!s_inFrame) {
+        // Discard the partial text command (if any), it was cut off by the frame
+        if (s_bufferIndex > 0 || s_tooLong) {
+          s_requestResend(s_expectedLineNumber, F("Incomplete command"), "<unknown>");
+          s_rejectCommand();
+        }
+        s_inFrame = true;
+      }
+
+      s_tooLong = false;
+      s_resetCommand();
+      continue;
+    }
+
+    // Add byte to frame
+    if (s_inFrame) {
+      if (s_bufferIndex < MAX_CMD_SIZE) {
+        s_buffer[s_bufferIndex++] = ch;
+      } else if (!s_tooLong) {
+        s_tooLong = true;
+        logError
+          << F("Unable to process command, binary frame is too long, ")
+          << F("will ignore until end of frame found")
+          << endl;
+      }
+      continue;
+    }
+#endif
 
     // End of command
-    } else if (ch == '\n' || ch == '\r') {
+    if (ch == '\n' || ch == '\r') {
       // Handle long lines
       if (s_tooLong) {
         log << F("Finished receiving long command") << endl;
-        s_sendResponseOk();
-
         s_tooLong = false;
+        s_ignoreLongCommand();
       } else {
         // Add to command queue
         s_buffer[s_bufferIndex] = 0; // terminate string
-        const char* command = parse(s_buffer, s_bufferIndex, s_expectedLineNumber);
+        const char* command = parse(s_buffer, s_bufferIndex, s_expectedLineNumber, s_checksum);
         if (command) {
-          command_queue.push(command);
+          s_acceptCommand(command);
+        } else {
+          s_rejectCommand();
         }
       }
 
-      // Increment
-      // Note: we increment if we
-      //       - request re-send
-      //       - send an ok now
-      //       - if we accept the command (and will send an ok later)
-      // TODO: smells weird, should eliminate command queue
-      ++s_expectedLineNumber;
-
       // Reset the write position for the next command
-      s_bufferIndex = 0;
+      s_resetCommand();
 
 
     // Command too long, report
@@ -189,6 +626,7 @@ static void read_commands() {
     // Add character to command
     } else {
       s_buffer[s_bufferIndex++] = ch;
+      s_updateChecksum(ch);
     }
   }
 }
@@ -197,33 +635,32 @@ void flushSerialCommands() {
   log << F("Flushing commands") << endl;
 
   // Clear queued commands
+  // Note: in windowed mode the resend is requested from the last line
+  //       acknowledged (see s_finishFlush)
   command_queue.flush();
 
   // Clear the message buffer
-  // Note: might have a partial message there
-  s_bufferIndex = 0;
-
-  // Wait then flush
-  // Note: There is a race between the app and this attempt to flush, so give
-  //       the app some extra time to send. This also allows data that is
-  //       in transit to arrive and be flushed.
-  delay(1000);
-  const auto numAvailable = MYSERIAL.available();
-  MYSERIAL.flush();
-  log << F("Flushed ") << numAvailable << (" bytes ") << endl;
-
-  if (numAvailable > 0) {
-    s_requestResend(
-      s_expectedLineNumber,
-      F("Flushed serial buffer"),
-      "<unknown>"
-    );
-    ++s_expectedLineNumber;
-  }
+  // Note: might have a partial message there, if it is a binary frame the
+  //       rest of it is still discarded as a frame (see s_continueFlush)
+  s_resetCommand();
+
+  // Discard received bytes (see s_continueFlush)
+  s_flushing = true;
+  s_flushIdleSince = millis();
+  s_flushedBytes = 0;
+  s_continueFlush();
 }
 
 
 static void process_command() {
+#if ENABLED(BINARY_COMMANDS)
+  if (binaryCommand::isBinary(command_queue.front())) {
+    process_binary_command();
+    return;
+  }
+#endif
+
+  tokenize_command();
   if        (command_prefix_seen('V')) { int code = (int)code_value(); process_vcode(code_seen('?') ? -1 : code);
   } else if (command_prefix_seen('D')) { int code = (int)code_value(); process_dcode(code_seen('?') ? -1 : code);
   } else if (command_prefix_seen('I')) { int code = (int)code_value(); process_icode(code_seen('?') ? -1 : code);
@@ -255,15 +692,35 @@ void processSerialCommands() {
     refresh_serial_rx_timeout();
     refresh_cmd_timeout();
 
+    const auto lineNumber = command_queue.frontLineNumber();
+    logging::tagErrors = s_windowed;
+    logging::errorLineNumber = lineNumber;
     process_command();
+    const auto acknowledged = command_queue.frontAcknowledged();
+    #if ENABLED(PROTOCOL_STATS)
+      const auto receivedAt = command_queue.frontReceivedAt();
+    #endif
     command_queue.pop();
 
     // Check end-stops so that synchronous commands
     // will report errors before sending OK
+    // Note: the hit may be from an earlier move, still the errors are tagged
+    //       with this command's line, the move's ok has been sent already
     checkForEndstopHits();
-
-    // Send Acknowledgement
-    s_sendResponseOk();
+    logging::tagErrors = false;
+
+    // Send Acknowledgement (unless sent on receipt)
+    // Note: deferred if the command started a flush (see s_finishFlush)
+    if (!acknowledged) {
+      s_deferredOk.pending = true;
+      s_deferredOk.lineNumber = lineNumber;
+      #if ENABLED(PROTOCOL_STATS)
+        s_deferredOk.receivedAt = receivedAt;
+      #endif
+      if (!s_flushing) {
+        s_sendDeferredOk();
+      }
+    }
 
     // Refresh the timeout after processing so that the user/sw
     // has then entire timeout duration to issue another command
@@ -0,0 +1,316 @@
+// Protocol harness
+// Runs the firmware's command protocol (process_serial_commands.cpp, the
+// command queue, ack policy and parsing) natively, behind a MarlinSerial
+// stand-in backed by a pseudo-terminal, so a host (e.g. windowed_host.py) can
+// stream jobs to it. The serial link is paced at the baud rate, with receive
+// and transmit buffers of RX_BUFFER_SIZE and TX_BUFFER_SIZE, and noise can be
+// injected into the bytes received. Commands are not executed, they take a
+// fixed time to process. Built and run by protocol_harness.py.
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <random>
+
+#include "serial.h"
+#include "src/commands/processing.h"
+#include "src/work/work.h"
+
+static struct {
+  unsigned long baud = BAUDRATE;
+  double noise = 0;           // fraction of received bytes to change
+  double drop = 0;            // fraction of received bytes to drop
+  unsigned long moveUs = 500; // time to process a move
+  unsigned long commandUs = 50;
+  unsigned long seed = 1;
+  const char* linkFile = nullptr;
+} s_options;
+
+static struct {
+  unsigned long received = 0;
+  unsigned long changed = 0;
+  unsigned long dropped = 0;
+  unsigned long overflowed = 0; // bytes lost because the receive buffer was full
+  unsigned long highWater = 0;
+  unsigned long sent = 0;
+  unsigned long commands = 0;
+} s_stats;
+
+static volatile sig_atomic_t s_stop = 0;
+static int s_fd = -1;
+static std::mt19937 s_random;
+
+// Time
+static uint64_t s_nowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+static const uint64_t s_startUs = s_nowUs();
+unsigned long millis() { return (s_nowUs() - s_startUs) / 1000; }
+unsigned long micros() { return s_nowUs() - s_startUs; }
+
+static double s_byteUs() { return 10 * 1000000.0 / s_options.baud; }
+
+// Serial link
+// Bytes are read from the pty no faster than the baud rate allows, and stored
+// in a ring of RX_BUFFER_SIZE (like the receive isr), bytes that arrive when
+// it is full are lost. Bytes written are queued (at most TX_BUFFER_SIZE,
+// writes wait for room) and passed to the pty as they would finish sending.
+static uint8_t s_rxBuffer[RX_BUFFER_SIZE];
+static unsigned s_rxHead = 0;
+static unsigned s_rxTail = 0;
+static uint64_t s_rxCreditedAt = 0;
+static double s_rxCredit = 0;
+
+struct PendingByte {
+  uint64_t sentAt;
+  uint8_t value;
+};
+static std::deque<PendingByte> s_txQueue;
+
+static unsigned s_rxQueued() { return (s_rxHead - s_rxTail) % RX_BUFFER_SIZE; }
+
+static void s_storeReceived(uint8_t byte) {
+  ++s_stats.received;
+  if (s_options.drop > 0 && std::uniform_real_distribution<>()(s_random) < s_options.drop) {
+    ++s_stats.dropped;
+    return;
+  }
+  if (s_options.noise > 0 && std::uniform_real_distribution<>()(s_random) < s_options.noise) {
+    ++s_stats.changed;
+    byte ^= 1 << std::uniform_int_distribution<>(0, 7)(s_random);
+  }
+
+  const unsigned next = (s_rxHead + 1) % RX_BUFFER_SIZE;
+  if (next == s_rxTail) {
+    ++s_stats.overflowed;
+    return;
+  }
+  s_rxBuffer[s_rxHead] = byte;
+  s_rxHead = next;
+  NOLESS(s_stats.highWater, s_rxQueued());
+}
+
+static void s_receive(uint64_t now) {
+  // Credit the bytes the link could have carried since the last call, unused
+  // credit is lost (the line was idle)
+  s_rxCredit += (now - s_rxCreditedAt) / s_byteUs();
+  s_rxCreditedAt = now;
+
+  uint8_t bytes[256];
+  while (s_rxCredit >= 1) {
+    const size_t wanted = s_rxCredit < sizeof(bytes) ? size_t(s_rxCredit) : sizeof(bytes);
+    const auto count = ::read(s_fd, bytes, wanted);
+    if (count <= 0) {
+      s_rxCredit -= int(s_rxCredit);
+      return;
+    }
+    s_rxCredit -= count;
+    for (auto i = 0; i < count; ++i) {
+      s_storeReceived(bytes[i]);
+    }
+  }
+}
+
+static void s_transmit(uint64_t now) {
+  uint8_t bytes[256];
+  size_t count = 0;
+  while (!s_txQueue.empty() && s_txQueue.front().sentAt <= now && count < sizeof(bytes)) {
+    bytes[count++] = s_txQueue.front().value;
+    s_txQueue.pop_front();
+  }
+  if (count && ::write(s_fd, bytes, count) != ssize_t(count)) {
+    // The host is not reading, drop the output rather than stall
+    return;
+  }
+  s_stats.sent += count;
+}
+
+// Stands in for the serial isrs, call while waiting
+static void s_serviceLink() {
+  const auto now = s_nowUs();
+  s_receive(now);
+  s_transmit(now);
+}
+
+MarlinSerial customizedSerial;
+
+int MarlinSerial::available() {
+  s_serviceLink();
+  return s_rxQueued();
+}
+
+int MarlinSerial::read() {
+  s_serviceLink();
+  if (s_rxHead == s_rxTail) {
+    return -1;
+  }
+  const uint8_t byte = s_rxBuffer[s_rxTail];
+  s_rxTail = (s_rxTail + 1) % RX_BUFFER_SIZE;
+  return byte;
+}
+
+void MarlinSerial::write(uint8_t c) {
+  while (TX_BUFFER_SIZE > 0 && s_txQueue.size() >= TX_BUFFER_SIZE) {
+    s_serviceLink();
+  }
+  const auto now = s_nowUs();
+  const auto previous = s_txQueue.empty() ? now : s_txQueue.back().sentAt;
+  s_txQueue.push_back({ (previous > now ? previous : now) + uint64_t(s_byteUs()), c });
+}
+
+void MarlinSerial::print(long value) {
+  char text[16];
+  snprintf(text, sizeof(text), "%ld", value);
+  write(text);
+}
+
+void MarlinSerial::print(unsigned long value) {
+  char text[16];
+  snprintf(text, sizeof(text), "%lu", value);
+  write(text);
+}
+
+void MarlinSerial::print(double value, int digits) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  write(text);
+}
+
+// Command processing
+// Commands take a fixed time, the link is serviced meanwhile
+static void s_process(unsigned long us) {
+  ++s_stats.commands;
+  const auto until = s_nowUs() + us;
+  while (s_nowUs() < until) {
+    s_serviceLink();
+  }
+}
+
+int process_gcode(int code) {
+  s_process(code >= 0 && code <= 3 ? s_options.moveUs : s_options.commandUs);
+  return 0;
+}
+
+int process_mcode(int code) {
+  if (code == 130) {
+    if (code_seen('W')) {
+      setWindowedProtocol(code_value_long());
+    }
+    log << F("Windowed protocol:") << windowedProtocol() << F(" window:") << BUFSIZE << endl;
+  }
+  s_process(s_options.commandUs);
+  return 0;
+}
+
+int process_dcode(int code) {
+  if (code == 7) {
+    #if ENABLED(PROTOCOL_STATS)
+      if (code_seen('R')) {
+        resetProtocolStats();
+      }
+      outputProtocolStats();
+    #else
+      logError << F("Unable to output protocol stats, PROTOCOL_STATS is not enabled") << endl;
+      return -1;
+    #endif
+  }
+  s_process(s_options.commandUs);
+  return 0;
+}
+
+int process_vcode(int) { s_process(s_options.commandUs); return 0; }
+int process_icode(int) { s_process(s_options.commandUs); return 0; }
+int process_binary_command() { s_process(s_options.moveUs); return 0; }
+
+void refresh_cmd_timeout() {}
+void refresh_serial_rx_timeout() {}
+void checkForEndstopHits() {}
+
+static void s_usage(const char* name) {
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "  -b, --baud N        serial link speed (default=%d)\n"
+    "  -n, --noise F       fraction of received bytes to change a bit in (default=0)\n"
+    "  -d, --drop F        fraction of received bytes to drop (default=0)\n"
+    "  -m, --move-us N     time to process a move (default=500)\n"
+    "  -c, --command-us N  time to process other commands (default=50)\n"
+    "  -s, --seed N        random seed for noise (default=1)\n"
+    "  -l, --link FILE     write the pty's path to FILE, once it is ready\n",
+    name, BAUDRATE);
+}
+
+int main(int argc, char* argv[]) {
+  static const option options[] = {
+    { "baud", required_argument, nullptr, 'b' },
+    { "noise", required_argument, nullptr, 'n' },
+    { "drop", required_argument, nullptr, 'd' },
+    { "move-us", required_argument, nullptr, 'm' },
+    { "command-us", required_argument, nullptr, 'c' },
+    { "seed", required_argument, nullptr, 's' },
+    { "link", required_argument, nullptr, 'l' },
+    { nullptr, 0, nullptr, 0 }
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "b:n:d:m:c:s:l:", options, nullptr)) != -1) {
+    switch (option) {
+      case 'b': s_options.baud = strtoul(optarg, nullptr, 10); break;
+      case 'n': s_options.noise = atof(optarg); break;
+      case 'd': s_options.drop = atof(optarg); break;
+      case 'm': s_options.moveUs = strtoul(optarg, nullptr, 10); break;
+      case 'c': s_options.commandUs = strtoul(optarg, nullptr, 10); break;
+      case 's': s_options.seed = strtoul(optarg, nullptr, 10); break;
+      case 'l': s_options.linkFile = optarg; break;
+      default: s_usage(argv[0]); return 2;
+    }
+  }
+  s_random.seed(s_options.seed);
+
+  // Note: the slave end is kept open, so reads do not fail between hosts
+  int slave;
+  termios settings;
+  if (openpty(&s_fd, &slave, nullptr, nullptr, nullptr) != 0 || tcgetattr(slave, &settings) != 0) {
+    perror("Unable to open a pty");
+    return 1;
+  }
+  cfmakeraw(&settings);
+  tcsetattr(slave, TCSANOW, &settings);
+  fcntl(s_fd, F_SETFL, fcntl(s_fd, F_GETFL) | O_NONBLOCK);
+
+  const char* link = ttyname(slave);
+  if (s_options.linkFile) {
+    FILE* file = fopen(s_options.linkFile, "w");
+    if (!file) {
+      perror("Unable to write the link file");
+      return 1;
+    }
+    fprintf(file, "%s\n", link);
+    fclose(file);
+  }
+  fprintf(stderr, "Protocol harness listening on %s\n", link);
+
+  signal(SIGINT, [](int) { s_stop = 1; });
+  signal(SIGTERM, [](int) { s_stop = 1; });
+
+  s_rxCreditedAt = s_nowUs();
+  while (!s_stop) {
+    processSerialCommands();
+    if (!MYSERIAL.available() && s_txQueue.empty()) {
+      usleep(50);
+    }
+  }
+
+  fprintf(stderr,
+    "Link: received:%lu changed:%lu dropped:%lu overflowed:%lu rxHighWater:%lu/%d sent:%lu commands:%lu\n",
+    s_stats.received, s_stats.changed, s_stats.dropped, s_stats.overflowed,
+    s_stats.highWater, RX_BUFFER_SIZE - 1, s_stats.sent, s_stats.commands);
+  return 0;
+}
@@ -0,0 +1,73 @@
+""" Build firmware sources natively, for the protocol harness, native tests and simulate_heater.py.
+
+The firmware sources are copied into a build directory, with the stand-ins in
+stubs/ replacing the Arduino and AVR headers, and compiled with the
+configuration in Configuration.h (see protocol_harness.py and native_tests.py).
+"""
+
+import os
+import shutil
+import subprocess
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MARLIN = os.path.normpath(os.path.join(HERE, '..', '..', '..'))
+
+# Note: features are enabled with an empty definition, see ENABLED() in macros.h
+FEATURES = ['-DMODEL=6', '-DFIRMWARE_VARIANT_SUFFIX="_batch6"']  # see build.sh
+
+# The command protocol (see protocol_harness.py), relative to Marlin/
+PROTOCOL_SOURCES = [
+    'macros.h',
+    'Configuration.h',
+    'serial.h',
+    'serial.cpp',
+    'src/commands/AckPolicy.h',
+    'src/commands/AckPolicy.cpp',
+    'src/commands/CommandQueue.h',
+    'src/commands/CommandQueue.cpp',
+    'src/commands/binaryCommand.h',
+    'src/commands/processing.h',
+    'src/commands/processing.cpp',
+    'src/utils/cobs.h',
+    'src/utils/crc8.h',
+    'src/utils/crc8.cpp',
+    'src/utils/crc16.h',
+    'src/utils/parseNumber.h',
+    'src/utils/parseNumber.cpp',
+    'src/work/work.h',
+    'src/work/process_serial_commands.cpp',
+]
+
+
+def stage(build_dir, sources):
+    """ Copy the sources (relative to Marlin/) and the stubs into build_dir """
+    for path in sources:
+        destination = os.path.join(build_dir, path)
+        os.makedirs(os.path.dirname(destination), exist_ok=True)
+        shutil.copy(os.path.join(MARLIN, path), destination)
+    for root, _, files in os.walk(os.path.join(HERE, 'stubs')):
+        for name in files:
+            source = os.path.join(root, name)
+            destination = os.path.join(build_dir, os.path.relpath(source, os.path.join(HERE, 'stubs')))
+            os.makedirs(os.path.dirname(destination), exist_ok=True)
+            shutil.copy(source, destination)
+
+
+def build(build_dir, main, sources, cxx='g++', features=(), libs=(), support=()):
+    """ Build main with the sources, returns the executable
+
+    main and support (e.g. headers and stand-ins it needs) are paths relative
+    to this directory, and are copied to the top of build_dir.
+    """
+    stage(build_dir, sources)
+    for path in [main] + list(support):
+        shutil.copy(os.path.join(HERE, path), build_dir)
+    name = os.path.basename(main)
+    executable = os.path.join(build_dir, os.path.splitext(name)[0])
+    compiled = [path for path in sources if path.endswith('.cpp')]
+    compiled += [os.path.basename(path) for path in support if path.endswith('.cpp')]
+    subprocess.check_call(
+        [cxx, '-std=gnu++14', '-O2', '-Wall', '-Wextra', '-I', build_dir] + FEATURES + list(features) +
+        ['-o', executable, name] + compiled + list(libs),
+        cwd=build_dir)
+    return executable
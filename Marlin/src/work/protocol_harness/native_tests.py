@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+
+""" Build and run the native tests and benchmarks, without a printer.
+
+Each test (in tests/) is built natively with the firmware sources it covers
+(see native_build.py) and run, a test fails if it returns non-zero. A test
+with a script of the same name (e.g. tests/binary_commands_test.py) is run by
+the script, which is passed the executable. Benchmarks
+check their results too, but are only run when asked for, since they take
+longer, and their timings are only comparable on the same machine.
+
+Usage: ./native_tests.py [--benchmarks] [name ...]
+Requires g++.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from native_build import HERE, PROTOCOL_SOURCES, build
+
+# Firmware sources for logging, to the console (see tests/console_serial.cpp)
+CONSOLE = ['macros.h', 'Configuration.h', 'serial.h', 'serial.cpp']
+
+# Test => firmware sources it is built with, relative to Marlin/
+TESTS = {
+    'parse_number_test': ['src/utils/parseNumber.h', 'src/utils/parseNumber.cpp'],
+    'command_queue_test': CONSOLE + [
+        'src/commands/CommandQueue.h',
+        'src/commands/CommandQueue.cpp',
+        'src/commands/binaryCommand.h',
+    ],
+    'binary_commands_test': PROTOCOL_SOURCES + ['src/commands/binaryCommand.cpp'],
+    'pid_controller_test': ['src/vone/bed/heater/PidController.h'],
+    'planner_handoff_test': CONSOLE + [
+        'Axis.h',
+        'planner.h',
+        'planner.cpp',
+        'stepper.h',
+        'src/api/movement/movement.h',
+        'src/api/movement/Point2d.h',
+        'src/api/movement/Point3d.h',
+        'src/compensationAlgorithms/api.h',
+        'src/compensationAlgorithms/backlash.cpp',
+        'src/compensationAlgorithms/scaling.cpp',
+        'src/compensationAlgorithms/skew.cpp',
+    ],
+}
+
+# Features a test is built with, in addition to Configuration.h's
+# Note: features are enabled with an empty definition, see ENABLED() in macros.h
+TEST_FEATURES = {
+    'binary_commands_test': ['-DBINARY_COMMANDS='],
+}
+
+# Libraries a test is linked with
+TEST_LIBS = {
+    'planner_handoff_test': ['-pthread'],
+}
+
+BENCHMARKS = {
+    'crc8_benchmark': ['src/utils/crc8.h', 'src/utils/crc8.cpp'],
+    'dispatch_benchmark': CONSOLE + [
+        'src/commands/CommandQueue.h',
+        'src/commands/CommandQueue.cpp',
+        'src/commands/binaryCommand.h',
+        'src/commands/processing.h',
+        'src/commands/processing.cpp',
+        'src/utils/parseNumber.h',
+        'src/utils/parseNumber.cpp',
+    ],
+    'thermistor_benchmark': CONSOLE + [
+        'MarlinConfig.h',
+        'src/utils/ScopedInterruptDisable.h',
+        'src/vone/pins/adc/SampledValue.h',
+        'src/vone/pins/adc/SamplingHelper.h',
+        'src/vone/pins/BedTemperaturePin/BedTemperaturePin.h',
+        'src/vone/pins/BedTemperaturePin/ThermistorLookupTable.h',
+        'src/vone/pins/BedTemperaturePin/ThermistorTable.h',
+    ],
+}
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('names', nargs='*', help='tests or benchmarks to run (default=all tests)')
+parser.add_argument('-b', '--benchmarks', action='store_true', help='run the benchmarks too')
+parser.add_argument('--build-dir', help='directory to build in (default=a temporary directory)')
+parser.add_argument('--cxx', default=os.environ.get('CXX', 'g++'), help='compiler (default=$CXX or g++)')
+args = parser.parse_args()
+
+
+def run(build_dir):
+    programs = dict(TESTS, **BENCHMARKS)
+    names = args.names or list(TESTS) + (list(BENCHMARKS) if args.benchmarks else [])
+    unknown = [name for name in names if name not in programs]
+    if unknown:
+        sys.exit('Unknown test: ' + ', '.join(unknown))
+
+    failed = []
+    for name in names:
+        print('== ' + name, flush=True)
+        directory = os.path.join(build_dir, name)
+        os.makedirs(directory, exist_ok=True)
+        sources = programs[name]
+        support = ['tests/test.h', 'tests/benchmark.h'] + (['tests/console_serial.cpp'] if 'serial.cpp' in sources else [])
+        try:
+            executable = build(
+                directory, os.path.join('tests', name + '.cpp'), sources,
+                cxx=args.cxx, features=TEST_FEATURES.get(name, []),
+                libs=TEST_LIBS.get(name, []), support=support)
+        except subprocess.CalledProcessError:
+            failed.append(name)
+            continue
+        script = os.path.join(HERE, 'tests', name + '.py')
+        command = [sys.executable, script, executable] if os.path.exists(script) else [executable]
+        if subprocess.call(command, cwd=directory, stdin=subprocess.DEVNULL) != 0:
+            failed.append(name)
+
+    print('%d of %d passed' % (len(names) - len(failed), len(names)) + (', failed: ' + ', '.join(failed) if failed else ''))
+    return 1 if failed else 0
+
+
+if args.build_dir:
+    os.makedirs(args.build_dir, exist_ok=True)
+    sys.exit(run(args.build_dir))
+with tempfile.TemporaryDirectory() as build_dir:
+    sys.exit(run(build_dir))
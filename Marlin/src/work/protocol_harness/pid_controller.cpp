@@ -0,0 +1,34 @@
+// PID controller
+// Runs the firmware's bed PID controller (PidController.h) natively, so
+// simulate_heater.py can drive its model of the bed with it. Commands are read
+// from stdin, one per line, and each update's output is written to stdout:
+//   gains <kp> <ki> <kd> <period>   see PidController::setGains
+//   reset
+//   update <target> <current> <feedforward>  temperatures in C
+// Built and run by simulate_heater.py.
+#include <stdio.h>
+#include <string.h>
+
+#include "src/vone/bed/heater/PidController.h"
+
+int main() {
+  PidController controller;
+  char line[128];
+  while (fgets(line, sizeof(line), stdin)) {
+    float kp, ki, kd, period, target, current;
+    unsigned feedforward;
+    if (sscanf(line, "gains %f %f %f %f", &kp, &ki, &kd, &period) == 4) {
+      controller.setGains(kp, ki, kd, period);
+    } else if (strcmp(line, "reset\n") == 0) {
+      controller.reset();
+    } else if (sscanf(line, "update %f %f %u", &target, &current, &feedforward) == 3) {
+      printf("%u\n", controller.update(
+        PidController::toFixed(target), PidController::toFixed(current), feedforward));
+      fflush(stdout);
+    } else {
+      fprintf(stderr, "Unknown command: %s", line);
+      return 1;
+    }
+  }
+  return 0;
+}
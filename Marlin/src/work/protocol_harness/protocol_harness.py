@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+
+""" Measure the command protocol natively, without a printer.
+
+Builds the firmware's command protocol code (process_serial_commands.cpp, the
+command queue, ack policy and parsing) for Linux, behind a MarlinSerial
+stand-in backed by a pseudo-terminal (see harness.cpp), then streams a job to
+it with windowed_host.py, which reports commands per second, resends and the
+ack latency distribution. Noise (changed or dropped bytes) can be injected on
+the link, in addition to the line corruption windowed_host.py injects, so
+protocol changes can be compared against a repeatable baseline.
+
+The firmware sources are built natively (see native_build.py), with the
+configuration in Configuration.h (plus PROTOCOL_STATS, so D7 works).
+
+Usage: ./protocol_harness.py job.gcode --noise 0.0001 -- --window 8 --stats
+Requires g++ and pyserial.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+from native_build import HERE, PROTOCOL_SOURCES, build as native_build
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('gcode', help='job to stream, e.g. a recorded print')
+parser.add_argument('-b', '--baud', type=int, default=250000, help='link speed (default=250000, i.e. BAUDRATE)')
+parser.add_argument('-n', '--noise', type=float, default=0, help='fraction of received bytes to change a bit in (default=0)')
+parser.add_argument('-d', '--drop', type=float, default=0, help='fraction of received bytes to drop (default=0)')
+parser.add_argument('-m', '--move-us', type=int, default=500, help='time to process a move (default=500)')
+parser.add_argument('-c', '--command-us', type=int, default=50, help='time to process other commands (default=50)')
+parser.add_argument('-s', '--seed', type=int, default=1, help='random seed for noise (default=1)')
+parser.add_argument('--binary', action='store_true', help='build with BINARY_COMMANDS (and pass --binary to the host)')
+parser.add_argument('--build-dir', help='directory to build in (default=a temporary directory)')
+parser.add_argument('--cxx', default=os.environ.get('CXX', 'g++'), help='compiler (default=$CXX or g++)')
+
+# Arguments after -- are passed to windowed_host.py
+argv = sys.argv[1:]
+host_args = argv[argv.index('--') + 1:] if '--' in argv else []
+args = parser.parse_args(argv[:len(argv) - len(host_args) - (1 if '--' in argv else 0)])
+
+
+def build(build_dir):
+    features = ['-DPROTOCOL_STATS='] + (['-DBINARY_COMMANDS='] if args.binary else [])
+    return native_build(build_dir, 'harness.cpp', PROTOCOL_SOURCES, cxx=args.cxx, features=features, libs=['-lutil'])
+
+
+def run(build_dir):
+    executable = build(build_dir)
+    link_file = os.path.join(build_dir, 'link')
+    if os.path.exists(link_file):
+        os.remove(link_file)
+
+    harness = subprocess.Popen([
+        executable,
+        '--baud', str(args.baud),
+        '--noise', str(args.noise),
+        '--drop', str(args.drop),
+        '--move-us', str(args.move_us),
+        '--command-us', str(args.command_us),
+        '--seed', str(args.seed),
+        '--link', link_file,
+    ])
+    try:
+        deadline = time.time() + 5
+        while not os.path.exists(link_file) or not open(link_file).read().endswith('\n'):
+            if harness.poll() is not None or time.time() > deadline:
+                sys.exit('The harness did not start')
+            time.sleep(0.01)
+        link = open(link_file).read().strip()
+
+        host = [sys.executable, os.path.join(HERE, '..', 'windowed_host.py'), link, args.gcode, '--baud', str(args.baud)]
+        return subprocess.call(host + (['--binary'] if args.binary else []) + host_args)
+    finally:
+        # The harness reports what happened on the link when it stops
+        harness.terminate()
+        harness.wait()
+
+
+if args.build_dir:
+    os.makedirs(args.build_dir, exist_ok=True)
+    sys.exit(run(args.build_dir))
+with tempfile.TemporaryDirectory() as build_dir:
+    sys.exit(run(build_dir))
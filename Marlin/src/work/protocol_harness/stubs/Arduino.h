@@ -0,0 +1,28 @@
+#pragma once
+
+// Native stand-ins for the Arduino functions used by the protocol code and
+// native tests
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avr/pgmspace.h"
+
+unsigned long millis();
+unsigned long micros();
+
+#ifndef F_CPU
+  #define F_CPU 16000000L
+#endif
+
+// As Arduino.h (and avr-libc, for square) define them
+#define _BV(bit) (1 << (bit))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+inline double square(double x) { return x * x; }
+
+// Registers, natively only written to (e.g. by ScopedInterruptDisable)
+static volatile uint8_t SREG;
+static volatile uint8_t DIDR0;
+inline void noInterrupts() {}
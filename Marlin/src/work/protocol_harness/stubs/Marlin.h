@@ -0,0 +1,13 @@
+#pragma once
+
+// Native stand-in, see protocol_harness.py
+#include "MarlinConfig.h"
+#include "serial.h"
+
+// Defined by the native tests that need them (e.g. planner_handoff_test.cpp)
+void periodic_work();
+extern int extrudemultiply;
+extern float volumetric_multiplier;
+
+class VOne;
+extern VOne* vone;
@@ -0,0 +1,6 @@
+#pragma once
+
+// Native stand-in, see protocol_harness.py
+#include "macros.h"
+#include "Configuration.h"
+#include "Arduino.h"
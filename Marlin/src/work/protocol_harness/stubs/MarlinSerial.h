@@ -0,0 +1,37 @@
+#pragma once
+
+// Native stand-in for MarlinSerial, backed by a pseudo-terminal (see harness.cpp)
+#include "MarlinConfig.h"
+
+#define DEC 10
+#define HEX 16
+
+class __FlashStringHelper;
+#define F(s) reinterpret_cast<const __FlashStringHelper*>(s)
+
+class MarlinSerial {
+  public:
+    static int read();
+    static int available();
+    static void write(uint8_t c);
+    static void write(const char* str) { while (*str) { write(uint8_t(*str++)); } }
+
+    static void print(const __FlashStringHelper* str) { write(reinterpret_cast<const char*>(str)); }
+    static void print(const char* str) { write(str); }
+    static void print(char c) { write(uint8_t(c)); }
+    static void print(int value) { print(long(value)); }
+    static void print(unsigned int value) { print((unsigned long)value); }
+    static void print(long value);
+    static void print(unsigned long value);
+    static void print(double value, int digits = 2);
+
+    // Responses are not reordered, and log lines are not dropped, natively
+    static void beginDroppableLine() {}
+    static void beginPriorityLine() {}
+    #if TX_PRIORITY_BUFFER_SIZE > 0
+      static uint32_t txPreempted() { return 0; }
+      static uint32_t txPreemptedBytes() { return 0; }
+    #endif
+};
+
+extern MarlinSerial customizedSerial;
@@ -0,0 +1,16 @@
+#pragma once
+
+// Native stand-in, for the motors the planner enables (see planner_handoff_test.cpp)
+class VOne {
+  public:
+    struct Motor {
+      void on() {}
+    };
+
+    struct {
+      Motor xAxis;
+      Motor yAxis;
+      Motor zAxis;
+      Motor eAxis;
+    } motors;
+};
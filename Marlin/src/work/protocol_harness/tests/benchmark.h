@@ -0,0 +1,38 @@
+#pragma once
+
+// Timing for the native benchmarks (see native_tests.py)
+// Timings are of the host, not the printer, they are only useful to compare
+// implementations built and run on the same machine.
+#include <stdio.h>
+
+#include <chrono>
+
+// Calls fn(i) for i in [0, count) several times, returns the fastest
+// nanoseconds per call
+template <typename Fn>
+double measureNs(unsigned long count, Fn fn) {
+  static const int Repeats = 5;
+  double best = 0;
+  for (int repeat = 0; repeat < Repeats; ++repeat) {
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < count; ++i) {
+      fn(i);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    const double perCall = elapsed.count() / count;
+    if (repeat == 0 || perCall < best) {
+      best = perCall;
+    }
+  }
+  return best;
+}
+
+// Keeps a result, so the work that produced it is not optimized away
+template <typename T>
+inline void keep(T value) {
+  asm volatile("" : : "g"(value) : "memory");
+}
+
+inline void reportNs(const char* name, double ns, const char* unit) {
+  printf("  %-32s %8.2f ns/%s\n", name, ns, unit);
+}
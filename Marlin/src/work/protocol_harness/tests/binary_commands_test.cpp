@@ -0,0 +1,36 @@
+// Binary command decoder, for binary_commands_test.py
+// Frames are received from stdin by the firmware's protocol code (COBS, CRC16
+// and line number checks, then binaryCommand.cpp), with the windowed protocol
+// enabled. The responses, and each move decoded, are written to stdout.
+#include <stdio.h>
+
+#include "serial.h"
+#include "src/commands/processing.h"
+#include "src/work/work.h"
+
+int process_gcode_move(const float position[NUM_AXIS], uint8_t axes, float feedrate) {
+  printf("move axes:%u", axes);
+  for (int i = 0; i < NUM_AXIS; ++i) {
+    printf(" %c:%.3f", "XYZE"[i], position[i]);
+  }
+  printf(" F:%.0f\n", feedrate);
+  return 0;
+}
+
+int process_gcode(int) { return 0; }
+int process_mcode(int) { return 0; }
+int process_dcode(int) { return 0; }
+int process_vcode(int) { return 0; }
+int process_icode(int) { return 0; }
+
+void refresh_cmd_timeout() {}
+void refresh_serial_rx_timeout() {}
+void checkForEndstopHits() {}
+
+int main() {
+  setWindowedProtocol(true);
+  while (!feof(stdin) || !command_queue.empty()) {
+    processSerialCommands();
+  }
+  return 0;
+}
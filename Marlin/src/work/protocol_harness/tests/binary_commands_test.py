@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+
+""" Round trip binary_commands.py frames through the firmware's decoder.
+
+Run by native_tests.py, with the decoder built from binary_commands_test.cpp.
+Moves encoded by binary_commands.py must be acknowledged, and decoded to the
+values encoded. Frames that are damaged (bad checksum, COBS encoding or line
+number, or too short) must be rejected with a resend request, and frames that
+are too long, or have a payload of the wrong size, with an error and an ok.
+
+Usage: binary_commands_test.py decoder
+"""
+
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+import binary_commands  # noqa: E402
+
+COMMANDS = 5000
+MAX_CMD_SIZE = 96  # see Configuration.h
+
+OK = re.compile(r'ok N(\d+) B\d+$')
+RESEND = re.compile(r'Resend lineNumber:(\d+), reason:"([^"]*)"')
+
+
+def float32(value):
+    return struct.unpack('<f', struct.pack('<f', value))[0]
+
+
+class Session:
+    """ The frames to send, and the responses expected """
+
+    def __init__(self):
+        self.data = b''
+        self.line = 1
+        self.expected = {'ok': [], 'resend': [], 'move': [], 'error': [], 'receive error': []}
+
+    def move(self, **axes):
+        self.data += binary_commands.move(self.line, **axes)
+        self.expected['ok'].append(self.line)
+
+        # Positions are decoded from micrometers as floats, see binaryCommand.cpp
+        included = sum(1 << i for i, axis in enumerate('xyze') if axis in axes)
+        decoded = ['axes:%u' % (included | (binary_commands.MOVE_FEEDRATE if 'f' in axes else 0))]
+        for axis in 'xyze':
+            decoded.append('%s:%.3f' % (axis.upper(), float32(int(round(axes.get(axis, 0) * 1000)) / 1000.0)))
+        decoded.append('F:%.0f' % axes.get('f', 0))
+        self.expected['move'].append('move ' + ' '.join(decoded))
+        self.line += 1
+
+    def rejected(self, frame, reason):
+        """ A frame the line is resent for, followed by the line """
+        self.data += frame
+        self.expected['resend'].append((self.line, reason))
+        self.random_move()
+
+    def failed(self, frame, error, tagged=True):
+        """ A frame that is acknowledged, with an error """
+        self.data += frame
+        self.expected['ok'].append(self.line)
+        if tagged:
+            self.expected['error'].append('N%d %s' % (self.line, error))
+        else:
+            self.expected['receive error'].append(error)
+        self.line += 1
+
+    def random_move(self):
+        axes = {}
+        for axis in 'xyze':
+            if random.random() < 0.6:
+                axes[axis] = random.choice([0, round(random.uniform(-2000, 2000), 3), round(random.uniform(-1, 1), 3)])
+        if random.random() < 0.5:
+            axes['f'] = random.randint(1, 0xFFFF)
+        self.move(**axes)
+
+
+def frame(data, checksum=None):
+    """ A frame of data, with its checksum (or the one given) """
+    data += struct.pack('<H', binary_commands.crc16(data) if checksum is None else checksum)
+    return b'\x00' + binary_commands.cobs_encode(data) + b'\x00'
+
+
+def build(session):
+    """ Mixes moves with damaged frames """
+    for _ in range(COMMANDS):
+        line = session.line
+        case = random.randrange(16)
+        header = struct.pack('<BH', binary_commands.MOVE, line)
+        if case == 0:
+            data = header + b'\x01' + struct.pack('<i', 1000)
+            session.rejected(frame(data, binary_commands.crc16(data) ^ (1 << random.randrange(16))), 'Bad checksum')
+        elif case == 1:
+            move = bytearray(binary_commands.move(line, x=1))
+            move[1] = len(move) + random.randrange(1, 100)  # the first block runs past the end of the frame
+            session.rejected(bytes(move), 'Bad frame')
+        elif case == 2:
+            session.rejected(b'\x00' + binary_commands.cobs_encode(header) + b'\x00', 'Bad frame')
+        elif case == 3:
+            session.rejected(binary_commands.move(line + random.randint(1, 5), x=1), 'Line number does not match expected value')
+        elif case == 4:
+            # Axes X and Y, with only X
+            session.failed(frame(header + b'\x03' + struct.pack('<i', 1000)), 'Unable to process binary move, expected 9 bytes, received 5')
+        elif case == 5:
+            session.failed(frame(struct.pack('<BH', 0x7F, line) + b'\x01'), 'Unable to process binary command, unknown opcode 127')
+        elif case == 6:
+            session.failed(
+                b'\x00' + bytes(random.randint(1, 255) for _ in range(MAX_CMD_SIZE + random.randint(1, 50))) + b'\x00',
+                'Unable to process command, binary frame is too long', tagged=False)
+        else:
+            session.random_move()
+
+
+def main():
+    random.seed(1)
+    session = Session()
+    build(session)
+
+    output = subprocess.run([sys.argv[1]], input=session.data, stdout=subprocess.PIPE, check=True).stdout
+    received = {'ok': [], 'resend': [], 'move': [], 'error': [], 'receive error': []}
+    for line in output.decode('ascii', 'replace').splitlines():
+        if OK.match(line):
+            received['ok'].append(int(OK.match(line).group(1)))
+        elif RESEND.match(line):
+            received['resend'].append((int(RESEND.match(line).group(1)), RESEND.match(line).group(2)))
+        elif line.startswith('move '):
+            received['move'].append(line)
+        elif line.startswith('error: N'):
+            received['error'].append(line[len('error: '):])
+        elif line.startswith('error: '):
+            received['receive error'].append(line[len('error: '):])
+
+    # Note: oks can be out of order, e.g. the ok for a frame that is too long
+    #       is sent immediately, and errors reported when frames are received
+    #       can precede those of earlier frames, reported when processed
+    received['ok'].sort()
+    session.expected['ok'].sort()
+
+    failed = False
+    for kind, expected in session.expected.items():
+        actual = received[kind]
+        if kind.endswith('error'):
+            # Note: errors can be longer than expected, e.g. include the command
+            actual = [a[:len(e)] for a, e in zip(actual, expected)] + actual[len(expected):]
+        for i, (a, e) in enumerate(zip(actual, expected)):
+            if a != e:
+                print('%s %d: received %s, expected %s' % (kind, i, a, e), file=sys.stderr)
+                failed = True
+                break
+        if len(actual) != len(expected):
+            print('received %d %s responses, expected %d' % (len(actual), kind, len(expected)), file=sys.stderr)
+            failed = True
+
+    if failed:
+        return 1
+    print('%d lines round tripped, with %d resends and %d errors as expected' % (
+        session.line - 1, len(session.expected['resend']),
+        len(session.expected['error']) + len(session.expected['receive error'])))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
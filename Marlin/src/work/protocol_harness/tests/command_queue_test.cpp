@@ -0,0 +1,132 @@
+// CommandQueue, compared against a model (a deque of the commands queued)
+// Random text and binary commands, of every size up to MAX_CMD_SIZE, are
+// pushed and popped, so commands are placed at every offset of the ring,
+// including those that wrap (i.e. are written after a wrap marker) and those
+// that end exactly at the end of the ring. Each command must come back intact
+// with its line number and acknowledgement, and the queue must report full
+// and free slots consistently with what can actually be pushed.
+#include <deque>
+#include <random>
+#include <string>
+
+#include "test.h"
+#include "src/commands/CommandQueue.h"
+#include "src/commands/binaryCommand.h"
+
+static const unsigned long Operations = 1000000;
+
+struct Queued {
+  std::string command; // as stored, including the terminator (text) or size (binary)
+  uint16_t lineNumber;
+  bool acknowledged;
+};
+
+static std::mt19937 s_random(1);
+
+static int s_below(int n) {
+  return std::uniform_int_distribution<>(0, n - 1)(s_random);
+}
+
+static std::string s_randomCommand(unsigned size) {
+  std::string command;
+  if (size >= 3 && s_below(4) == 0) {
+    // Binary, the payload may contain any byte (including zeros)
+    command += binaryCommand::Marker;
+    command += char(size - 2);
+    command += char(binaryCommand::Move);
+    while (command.size() < size) {
+      command += char(s_below(256));
+    }
+  } else {
+    while (command.size() < size - 1) {
+      command += char(' ' + 1 + s_below(94)); // never the marker
+    }
+    command += '\0';
+  }
+  return command;
+}
+
+static void s_checkFront(const CommandQueue& queue, const std::deque<Queued>& model) {
+  if (model.empty()) {
+    CHECK(queue.empty(), "the queue should be empty");
+    CHECK(*queue.front() == '\0', "front() of an empty queue should be an empty string");
+    return;
+  }
+
+  const auto& expected = model.front();
+  const char* front = queue.front();
+  CHECK(!queue.empty(), "the queue should hold %zu commands", model.size());
+  CHECK(binaryCommand::storedSize(front) == expected.command.size(), "size %u, expected %zu", binaryCommand::storedSize(front), expected.command.size());
+  CHECK(memcmp(front, expected.command.data(), expected.command.size()) == 0, "line %u was corrupted", expected.lineNumber);
+  CHECK(queue.frontLineNumber() == expected.lineNumber, "line %u, expected %u", queue.frontLineNumber(), expected.lineNumber);
+  CHECK(queue.frontAcknowledged() == expected.acknowledged, "line %u acknowledgement", expected.lineNumber);
+}
+
+// Pushing freeSlots() commands of MAX_CMD_SIZE must succeed, and fill the queue
+static void s_checkFreeSlots(const CommandQueue& queue, size_t queued) {
+  const auto slots = queue.freeSlots();
+  CHECK(queue.full() == (slots == 0), "full() is %d, with %u free slots", queue.full(), slots);
+
+  CommandQueue filled = queue;
+  const auto longest = std::string(MAX_CMD_SIZE - 1, 'G');
+  for (unsigned i = 0; i < slots; ++i) {
+    CHECK(!filled.full(), "full after %u of %u free slots", i, slots);
+    filled.push(longest.c_str());
+  }
+  CHECK(filled.full(), "not full after %u free slots", slots);
+
+  unsigned popped = 0;
+  for (; !filled.empty(); ++popped) {
+    filled.pop();
+  }
+  CHECK(popped == queued + slots, "popped %u commands, expected %zu", popped, queued + slots);
+}
+
+int main() {
+  CommandQueue queue;
+  std::deque<Queued> model;
+  uint16_t lineNumber = 0;
+
+  for (unsigned long i = 0; i < Operations; ++i) {
+    // Push (only when not full, like read_commands) or pop, favoring whichever
+    // keeps the queue part full
+    const bool push = !queue.full() && s_below(BUFSIZE) >= int(model.size()) / 2;
+    if (push) {
+      const auto size = 1 + s_below(s_below(8) ? 40 : MAX_CMD_SIZE);
+      const Queued command = { s_randomCommand(size), ++lineNumber, s_below(2) == 0 };
+      queue.push(command.command.data(), command.lineNumber, command.acknowledged);
+      model.push_back(command);
+    } else if (!model.empty() || s_below(16) == 0) {
+      queue.pop();
+      if (!model.empty()) {
+        model.pop_front();
+      }
+    }
+
+    s_checkFront(queue, model);
+    bool allAcknowledged = true;
+    for (const auto& command : model) {
+      allAcknowledged = allAcknowledged && command.acknowledged;
+    }
+    CHECK(queue.allAcknowledged() == allAcknowledged, "allAcknowledged() after operation %lu", i);
+    if (i % 16 == 0) {
+      s_checkFreeSlots(queue, model.size());
+    }
+
+    // Start over sometimes
+    if (s_below(100000) == 0) {
+      queue.flush();
+      model.clear();
+      s_checkFront(queue, model);
+    }
+
+    if (s_checkFailures > 10) {
+      break;
+    }
+  }
+
+  if (!s_checkFailures) {
+    printf("CommandQueue matched the model for %lu operations\n", Operations);
+  }
+  return testResult();
+}
@@ -0,0 +1,23 @@
+// MarlinSerial stand-in for the native tests, bytes are received from stdin
+// and sent to stdout (see stubs/MarlinSerial.h)
+#include <stdio.h>
+#include <time.h>
+
+#include "serial.h"
+
+static unsigned long s_nowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+unsigned long millis() { return s_nowUs() / 1000; }
+unsigned long micros() { return s_nowUs(); }
+
+MarlinSerial customizedSerial;
+
+int MarlinSerial::available() { return 0; }
+int MarlinSerial::read() { return getchar(); } // EOF is -1, i.e. nothing received
+void MarlinSerial::write(uint8_t c) { putchar(c); }
+void MarlinSerial::print(long value) { printf("%ld", value); }
+void MarlinSerial::print(unsigned long value) { printf("%lu", value); }
+void MarlinSerial::print(double value, int digits) { printf("%.*f", digits, value); }
@@ -0,0 +1,71 @@
+// crc8, the table (utils/crc8.cpp) against the bitwise algorithm it replaced
+// Checks both agree on random data, then times them per byte, over command
+// sized lines (as read_commands() checksums them) and one large buffer.
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "test.h"
+#include "src/utils/crc8.h"
+
+// The bitwise algorithm, as used before the table
+static uint8_t s_bitwiseCrc8(const void* data, unsigned int size) {
+  const auto bytes = reinterpret_cast<const uint8_t*>(data);
+  uint8_t crc = 0;
+  for (unsigned int i = 0; i < size; ++i) {
+    uint8_t byte = bytes[i];
+    for (uint8_t j = 0; j < 8; ++j) {
+      const uint8_t mix = (crc ^ byte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
+
+int main() {
+  std::mt19937 random(1);
+  std::vector<uint8_t> data(1 << 16);
+  for (auto& byte : data) {
+    byte = random();
+  }
+
+  // Agree, at every size and offset
+  for (unsigned i = 0; i < 10000; ++i) {
+    const auto size = random() % 200;
+    const auto offset = random() % (data.size() - size);
+    const auto expected = s_bitwiseCrc8(&data[offset], size);
+    const auto actual = crc8(&data[offset], size);
+    CHECK(actual == expected, "crc8 of %u bytes at %u is 0x%02X, expected 0x%02X", unsigned(size), unsigned(offset), actual, expected);
+  }
+
+  // A move, as sent by the host (i.e. checksummed up to the '*')
+  static const char line[] = "N1234 G1 X123.456 Y78.901 E0.12345 F1800";
+  const unsigned lineSize = sizeof(line) - 1;
+
+  printf("crc8 (per byte):\n");
+  reportNs("bitwise, line", measureNs(1000000, [&](unsigned long i) {
+    keep(s_bitwiseCrc8(line, lineSize - (i & 1)));
+  }) / lineSize, "byte");
+  reportNs("table, line", measureNs(1000000, [&](unsigned long i) {
+    keep(crc8(line, lineSize - (i & 1)));
+  }) / lineSize, "byte");
+  reportNs("table (crc8_update), line", measureNs(1000000, [&](unsigned long i) {
+    uint8_t crc = 0;
+    for (unsigned j = 0; j < lineSize - (i & 1); ++j) {
+      crc = crc8_update(crc, line[j]);
+    }
+    keep(crc);
+  }) / lineSize, "byte");
+  reportNs("bitwise, 64KB", measureNs(20, [&](unsigned long) {
+    keep(s_bitwiseCrc8(data.data(), data.size()));
+  }) / data.size(), "byte");
+  reportNs("table, 64KB", measureNs(20, [&](unsigned long) {
+    keep(crc8(data.data(), data.size()));
+  }) / data.size(), "byte");
+
+  return testResult();
+}
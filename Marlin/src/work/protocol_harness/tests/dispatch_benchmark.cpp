@@ -0,0 +1,115 @@
+// Command dispatch, the single pass tokenizer (commands/processing.cpp) against
+// searching for each parameter
+// Dispatching a command finds its prefix and code, then each parameter the
+// command handles (e.g. X, Y, Z, E and F for a move), as process_command() and
+// the g-code handlers do. Checks the tokenizer finds the same parameters and
+// values as searching, then times a dispatch both ways.
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+
+#include "benchmark.h"
+#include "test.h"
+#include "src/commands/processing.h"
+#include "src/utils/parseNumber.h"
+
+static const char* const s_commands[] = {
+  "G1 X123.456 Y78.901 E0.12345 F1800",
+  "G1 X10 Y20",
+  "G1 Z0.2 F600",
+  "G0 X-5.5 Y100.25 Z3",
+  "M104 S200",
+  "G92 E0",
+};
+
+// Searching for each parameter, the way processing.cpp did before tokenizing
+// (i.e. strchr, and parseFloat or strtod)
+template <float (*parse)(const char*)>
+static float s_searchDispatch(const char* command) {
+  float sum = 0;
+  const char* ptr = command;
+  while (*ptr == ' ') {
+    ++ptr;
+  }
+  if (*ptr == 'G' || *ptr == 'M') {
+    sum += parse(ptr + 1);
+  }
+  for (const char code : { 'X', 'Y', 'Z', 'E', 'F', 'S' }) {
+    if (const char* found = strchr(command, code)) {
+      sum += parse(found + 1);
+    }
+  }
+  return sum;
+}
+
+static float s_parseFloat(const char* str) { return parseFloat(str); }
+static float s_strtod(const char* str) { return strtod(str, nullptr); }
+
+// Using the tokenizer, as process_command() and the handlers do
+static float s_tokenizedDispatch() {
+  float sum = 0;
+  tokenize_command();
+  if (command_prefix_seen('G') || command_prefix_seen('M')) {
+    sum += code_value();
+  }
+  for (const char code : { 'X', 'Y', 'Z', 'E', 'F', 'S' }) {
+    if (code_seen(code)) {
+      sum += code_value();
+    }
+  }
+  return sum;
+}
+
+static std::string s_randomCommand(std::mt19937& random) {
+  std::string command = random() % 2 ? "G1" : "M104";
+  for (const char code : { 'X', 'Y', 'Z', 'E', 'F', 'S', 'X' }) {
+    if (random() % 2) {
+      command += ' ';
+      command += code;
+      command += std::to_string(int(random() % 20000) - 10000);
+      if (random() % 2) {
+        command += '.' + std::to_string(random() % 1000);
+      }
+    }
+  }
+  return command;
+}
+
+int main() {
+  // The tokenizer finds the same parameters (the first of each letter) and values
+  std::mt19937 random(1);
+  for (unsigned i = 0; i < 100000; ++i) {
+    const auto command = s_randomCommand(random);
+    command_queue.push(command.c_str());
+    tokenize_command();
+    for (char code = 'A'; code <= 'Z'; ++code) {
+      const char* expected = strchr(command.c_str(), code);
+      CHECK(code_seen(code) == (expected != nullptr), "code_seen('%c') in \"%s\"", code, command.c_str());
+      if (expected) {
+        CHECK(code_value() == parseFloat(expected + 1), "code_value() of '%c' in \"%s\"", code, command.c_str());
+        CHECK(code_value_raw() == command_queue.front() + (expected - command.c_str()) + 1, "code_value_raw() of '%c' in \"%s\"", code, command.c_str());
+      }
+    }
+    command_queue.pop();
+  }
+
+  printf("dispatch (per command):\n");
+  for (const auto command : s_commands) {
+    printf(" %s\n", command);
+    command_queue.push(command);
+    reportNs("search, strtod", measureNs(1000000, [command](unsigned long) {
+      keep(s_searchDispatch<s_strtod>(command));
+    }), "command");
+    reportNs("search, parseFloat", measureNs(1000000, [command](unsigned long) {
+      keep(s_searchDispatch<s_parseFloat>(command));
+    }), "command");
+    reportNs("tokenized", measureNs(1000000, [](unsigned long) {
+      keep(s_tokenizedDispatch());
+    }), "command");
+    command_queue.pop();
+  }
+
+  return testResult();
+}
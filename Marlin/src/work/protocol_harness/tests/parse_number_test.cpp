@@ -0,0 +1,103 @@
+// parseFixed, compared against strtod
+// Random decimal numbers (within parseDecimal's 9 significant digits) are
+// parsed with random numbers of decimal places, the result must be strtod's
+// value scaled and rounded half away from zero, or saturated.
+#include <math.h>
+#include <stdlib.h>
+
+#include <random>
+#include <string>
+
+#include "test.h"
+#include "src/utils/parseNumber.h"
+
+static const int32_t MaxFixed = 2147483647;
+static const unsigned long Trials = 1000000;
+
+static std::string s_randomDecimal(std::mt19937& random) {
+  const auto below = [&random](int n) { return std::uniform_int_distribution<>(0, n - 1)(random); };
+
+  std::string text(below(2), ' ');
+  text += "\0-+"[below(3)];
+  if (text.back() == '\0') {
+    text.pop_back();
+  }
+
+  // Note: leading zeros are not significant
+  const int zeros = below(3);
+  const int integerDigits = below(10);
+  const int fractionDigits = below(10 - integerDigits);
+  text += std::string(zeros, '0');
+  for (int i = 0; i < integerDigits; ++i) {
+    text += char('0' + below(10));
+  }
+  if (zeros + integerDigits == 0) {
+    text += '0';
+  }
+  if (fractionDigits || below(2)) {
+    text += '.';
+  }
+  for (int i = 0; i < fractionDigits; ++i) {
+    text += char('0' + below(10));
+  }
+
+  // Followed by another parameter, sometimes
+  if (below(2)) {
+    text += " X1";
+  }
+  return text;
+}
+
+static long s_expected(const char* text, uint8_t decimals) {
+  const long double scaled = strtod(text, nullptr) * powl(10, decimals);
+  if (scaled > MaxFixed) {
+    return MaxFixed;
+  } else if (scaled < -MaxFixed) {
+    return -MaxFixed;
+  }
+
+  // Round half away from zero
+  // Note: strtod's value may be just either side of a tie, the tolerance
+  //       is well below the distance of a 9 digit number from a tie
+  const long double magnitude = fabsl(scaled);
+  const long double fraction = magnitude - floorl(magnitude);
+  const bool tie = fabsl(fraction - 0.5L) <= (magnitude + 1) * 1e-14L;
+  const long rounded = tie ? long(floorl(magnitude)) + 1 : long(roundl(magnitude));
+  return scaled < 0 ? -rounded : rounded;
+}
+
+int main() {
+  // Examples
+  CHECK(parseFixed("1.2345", 3) == 1235, "rounds extra places");
+  CHECK(parseFixed("-2.5", 0) == -3, "rounds half away from zero");
+  CHECK(parseFixed(" +0.5", 0) == 1, "skips spaces, accepts a sign");
+  CHECK(parseFixed("12", 3) == 12000, "scales");
+  CHECK(parseFixed("3", 9) == MaxFixed, "saturates");
+  CHECK(parseFixed("-21.4748365", 8) == -MaxFixed, "saturates");
+  CHECK(parseFixed("21.4748364", 8) == 2147483640L, "fits");
+  CHECK(parseFixed("1", 12) == MaxFixed, "saturates when scaled by more than 10^9");
+  CHECK(parseFixed("0.0", 12) == 0, "zero is never saturated");
+
+  const char* text = "X";
+  const char* end = nullptr;
+  CHECK(parseFixed(text, 3, &end) == 0 && end == text, "no number");
+
+  // Against strtod
+  std::mt19937 random(1);
+  for (unsigned long i = 0; i < Trials; ++i) {
+    const auto number = s_randomDecimal(random);
+    const uint8_t decimals = std::uniform_int_distribution<>(0, 11)(random);
+
+    char* expectedEnd = nullptr;
+    strtod(number.c_str(), &expectedEnd);
+    const auto actual = parseFixed(number.c_str(), decimals, &end);
+    const auto expected = s_expected(number.c_str(), decimals);
+    CHECK(actual == expected, "parseFixed(\"%s\", %d) = %ld, expected %ld", number.c_str(), decimals, long(actual), expected);
+    CHECK(end == expectedEnd, "parseFixed(\"%s\") ended at \"%s\", expected \"%s\"", number.c_str(), end, expectedEnd);
+  }
+
+  if (!s_checkFailures) {
+    printf("parseFixed matched strtod for %lu numbers\n", Trials);
+  }
+  return testResult();
+}
@@ -0,0 +1,110 @@
+// PidController, the fixed-point arithmetic against the same controller in
+// floating point
+// A bed (heated through a lag, read through a noisy thermistor) is controlled
+// for a profile with target steps up and down, a ramp and feedforward, by
+// PidController. The floating point controller is given the same readings,
+// and its output must match at every step, to within the rounding of the
+// fixed point gains and terms.
+#include <math.h>
+
+#include <random>
+
+#include "test.h"
+#include "src/vone/bed/heater/PidController.h"
+
+static const float Period = 1; // s
+
+// PidController in floating point, with the same (i.e. rounded) gains
+class ReferenceController {
+  public:
+    ReferenceController(float kp, float ki, float kd)
+      : m_kp(int32_t(kp * 256) / 256.0)
+      , m_ki(int32_t(ki * 256 * Period) / 256.0)
+      , m_kd(int32_t(kd * 256 / Period) / 256.0)
+    {
+    }
+
+    double update(int16_t target, int16_t current, uint8_t feedforward) {
+      const double error = (target - current) / double(PidController::TemperatureScale);
+      if (!m_havePrevious) {
+        m_previous = current;
+        m_havePrevious = true;
+      }
+      m_derivative += (-m_kd * (current - m_previous) / PidController::TemperatureScale - m_derivative) / 4;
+      m_previous = current;
+
+      if (target - current > PidController::FunctionalRange) {
+        m_integral = 0;
+        return PidController::MaxOutput;
+      }
+      if (target - current < -PidController::FunctionalRange) {
+        m_integral = 0;
+        return 0;
+      }
+
+      const double integral = fmin(fmax(m_integral + m_ki * error, -feedforward), PidController::MaxOutput - feedforward);
+      const double unclamped = m_kp * error + integral + m_derivative + feedforward;
+      if (!((unclamped > PidController::MaxOutput && error > 0) || (unclamped < 0 && error < 0))) {
+        m_integral = integral;
+      }
+      return fmin(fmax(m_kp * error + m_integral + m_derivative + feedforward, 0), PidController::MaxOutput);
+    }
+
+  private:
+    double m_kp, m_ki, m_kd;
+    double m_integral = 0;
+    double m_derivative = 0;
+    int16_t m_previous = 0;
+    bool m_havePrevious = false;
+};
+
+int main() {
+  static const float Kp = 40, Ki = 4, Kd = 100; // see DEFAULT_bedKp
+  PidController controller;
+  controller.setGains(Kp, Ki, Kd, Period);
+  ReferenceController reference(Kp, Ki, Kd);
+
+  // Targets (C) and steps, the 150C step ramps at 0.5C/s
+  static const struct { float target; unsigned steps; } s_profile[] = {
+    { 120, 400 }, { 200, 400 }, { 150, 400 }, { 60, 300 },
+  };
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+  float heater = 25, plate = 25, sensor = 25, setpoint = 25;
+  unsigned steps = 0;
+  double maxDifference = 0;
+  for (const auto& step : s_profile) {
+    for (unsigned i = 0; i < step.steps; ++i, ++steps) {
+      const float rate = step.target == 150 ? 0.5f : 1000.0f;
+      setpoint += fmax(fmin(step.target - setpoint, rate * Period), -rate * Period);
+      const uint8_t feedforward = setpoint > 100 ? 40 : 0;
+
+      const int16_t target = PidController::toFixed(setpoint);
+      const int16_t current = PidController::toFixed(sensor + noise(random));
+      const uint8_t output = controller.update(target, current, feedforward);
+      const double expected = reference.update(target, current, feedforward);
+
+      // Fixed point truncates the gains, the filtered derivative and the output
+      const double difference = fabs(output - expected);
+      maxDifference = fmax(maxDifference, difference);
+      CHECK(difference < 1.5, "step %u, %.2fC at %.2fC, output %u, expected %.2f",
+        steps, current / 16.0, target / 16.0, output, expected);
+
+      // The bed, see simulate_heater.py
+      const float on = output / float(PidController::MaxOutput);
+      for (int j = 0; j < 20; ++j) {
+        const float dt = Period / 20;
+        const float flow = (heater - plate) / 8;
+        heater += dt * (8 * on - flow * 4);
+        plate += dt * (flow - (plate - 25) / 600);
+        sensor += dt * (plate - sensor) / 3;
+      }
+    }
+  }
+
+  if (!s_checkFailures) {
+    printf("PidController matched floating point for %u steps, within %.2f\n", steps, maxDifference);
+  }
+  return testResult();
+}
@@ -0,0 +1,242 @@
+// Planner to stepper isr handoff (see the block buffer notes in planner.h)
+// The planner (plan_buffer_line, and planner_recalculate's passes over the
+// queued blocks) runs on the main thread, as it does in loop(). The stepper
+// isr runs on a second thread, at random intervals. It interrupts the planner
+// (with a signal, which parks the main thread until the isr is done), so the
+// planner is stopped at an arbitrary point while the isr runs, as it is on the
+// printer. The isr claims blocks with plan_claim_current_block(), and checks
+// each block it runs:
+//   - is the next move planned, i.e. no block is lost or repeated
+//   - has the trapezoid settings of a single calculate_trapezoid_for_block(),
+//     i.e. is not torn
+//   - is not changed by the planner while it runs
+// Note: the planner is parked, rather than left running, since the
+//       updating/busy handshake relies on the planner not running while the
+//       isr does (i.e. an isr runs to completion).
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+#include "src/api/movement/movement.h"
+#include "src/vone/VOne.h"
+
+static const unsigned long Moves = 20000;
+static const float StepsPerMm = 80;
+
+// What the planner needs, natively
+int extrudemultiply = 100;
+float volumetric_multiplier = 1;
+static VOne s_vone;
+VOne* vone = &s_vone;
+
+void periodic_work() {}
+void st_set_position(const long&, const long&, const long&, const long&) {}
+void st_set_e_position(const long&) {}
+float stepsToMillimeters(long step, AxisEnum) { return step / StepsPerMm; }
+long millimetersToSteps(float mm, AxisEnum) { return lround(mm * StepsPerMm); }
+
+struct Move {
+  long dx, dy; // mm
+  float feedrate; // mm/s
+};
+static std::vector<Move> s_moves;
+
+// The stepper isr
+// Note: only touched by the isr, except to wait for it to finish
+static block_t* s_block = nullptr;     // the block running
+static block_t s_claimed;              // the block, when it was claimed
+static int s_ticksLeft = 0;            // until the block finishes
+static volatile unsigned long s_nextMove = 0;
+static unsigned long s_isrCalls = 0;
+static unsigned long s_claimsDeferred = 0; // the planner was updating the block
+static uint32_t s_isrRandom = 1;
+
+// The trapezoid calculate_trapezoid_for_block() derives from the rates
+static void s_expectedTrapezoid(const block_t& block, long& accelerateUntil, long& decelerateAfter) {
+  const float acceleration = long(block.acceleration_st);
+  const float accelerateDistance = acceleration != 0 ?
+    (float(block.nominal_rate) * block.nominal_rate - float(block.initial_rate) * block.initial_rate) / (2.0 * acceleration) : 0.0;
+  const float decelerateDistance = acceleration != 0 ?
+    (float(block.final_rate) * block.final_rate - float(block.nominal_rate) * block.nominal_rate) / (2.0 * -acceleration) : 0.0;
+  int32_t accelerateSteps = ceil(accelerateDistance);
+  int32_t plateauSteps = block.step_event_count - accelerateSteps - int32_t(floor(decelerateDistance));
+  if (plateauSteps < 0) {
+    const float intersection = acceleration != 0 ?
+      (2.0 * acceleration * float(block.step_event_count) - float(block.initial_rate) * block.initial_rate +
+        float(block.final_rate) * block.final_rate) / (4.0 * acceleration) : 0.0;
+    accelerateSteps = ceil(intersection);
+    accelerateSteps = max(accelerateSteps, 0);
+    accelerateSteps = min((uint32_t)accelerateSteps, block.step_event_count);
+    plateauSteps = 0;
+  }
+  accelerateUntil = accelerateSteps;
+  decelerateAfter = accelerateSteps + plateauSteps;
+}
+
+// The settings the stepper isr uses
+static bool s_sameSettings(const block_t& a, const block_t& b) {
+  return
+    a.steps_x == b.steps_x && a.steps_y == b.steps_y && a.steps_z == b.steps_z && a.steps_e == b.steps_e &&
+    a.step_event_count == b.step_event_count && a.direction_bits == b.direction_bits &&
+    a.accelerate_until == b.accelerate_until && a.decelerate_after == b.decelerate_after &&
+    a.acceleration_rate == b.acceleration_rate && a.acceleration_st == b.acceleration_st &&
+    a.nominal_rate == b.nominal_rate && a.initial_rate == b.initial_rate && a.final_rate == b.final_rate;
+}
+
+static void s_claim() {
+  s_block = plan_claim_current_block();
+  if (!s_block) {
+    if (blocks_queued()) {
+      ++s_claimsDeferred;
+    }
+    return;
+  }
+  s_claimed = *s_block;
+
+  const unsigned long index = s_nextMove;
+  CHECK(index < s_moves.size(), "claimed a block after the last move");
+  if (index < s_moves.size()) {
+    const auto& move = s_moves[index];
+    const unsigned char directions = (move.dx < 0 ? 1 << X_AXIS : 0) | (move.dy < 0 ? 1 << Y_AXIS : 0);
+    CHECK(
+      s_claimed.steps_x == labs(move.dx) * StepsPerMm && s_claimed.steps_y == labs(move.dy) * StepsPerMm &&
+        s_claimed.direction_bits == directions,
+      "move %lu has %ld, %ld steps (directions %u), expected %ld, %ld mm",
+      index, s_claimed.steps_x, s_claimed.steps_y, s_claimed.direction_bits, move.dx, move.dy);
+  }
+  s_nextMove = index + 1;
+
+  long accelerateUntil, decelerateAfter;
+  s_expectedTrapezoid(s_claimed, accelerateUntil, decelerateAfter);
+  CHECK(
+    s_claimed.accelerate_until == accelerateUntil && s_claimed.decelerate_after == decelerateAfter,
+    "move %lu is torn, rates %lu, %lu, %lu have trapezoid %ld, %ld, but the block has %ld, %ld",
+    index, s_claimed.initial_rate, s_claimed.nominal_rate, s_claimed.final_rate,
+    accelerateUntil, decelerateAfter, s_claimed.accelerate_until, s_claimed.decelerate_after);
+
+  s_isrRandom = s_isrRandom * 1103515245 + 12345;
+  s_ticksLeft = 1 + (s_isrRandom >> 16) % 4;
+}
+
+static void s_stepperIsr() {
+  ++s_isrCalls;
+  if (!s_block) {
+    s_claim();
+    return;
+  }
+  if (--s_ticksLeft > 0) {
+    return;
+  }
+
+  CHECK(s_sameSettings(*s_block, s_claimed), "move %lu was changed while it ran", s_nextMove - 1);
+  s_block = nullptr;
+  plan_discard_current_block();
+}
+
+// Interrupting the planner
+static sem_t s_plannerParked;
+static sem_t s_isrDone;
+
+static void s_parkPlanner(int) {
+  sem_post(&s_plannerParked);
+  while (sem_wait(&s_isrDone) != 0) {}
+}
+
+int main() {
+  // Moves of whole mm (i.e. whole steps), so their steps are known, with
+  // changes of direction and speed, so the planner re-plans queued blocks
+  std::mt19937 random(1);
+  for (unsigned long i = 0; i < Moves; ++i) {
+    Move move;
+    do {
+      move.dx = long(random() % 41) - 20;
+      move.dy = random() % 2 ? long(random() % 41) - 20 : 0;
+    } while (!move.dx && !move.dy);
+    move.feedrate = 5 + random() % 200;
+    s_moves.push_back(move);
+  }
+
+  for (auto i = 0u; i < NUM_AXIS; ++i) {
+    max_feedrate[i] = 200;
+    max_acceleration_units_per_sq_second[i] = 3000;
+  }
+  minimumfeedrate = 0;
+  mintravelfeedrate = 0;
+  acceleration = 1000;
+  retract_acceleration = 1000;
+  max_xy_jerk = 10;
+  max_z_jerk = 0.4;
+  max_e_jerk = 5;
+  calib_x_scale = 1;
+  calib_y_scale = 1;
+  calib_cos_theta = 1;
+  calib_tan_theta = 0;
+  calib_x_backlash = 0;
+  calib_y_backlash = 0;
+  reset_acceleration_rates();
+  plan_init();
+
+  sem_init(&s_plannerParked, 0, 0);
+  sem_init(&s_isrDone, 0, 0);
+  struct sigaction action = {};
+  action.sa_handler = s_parkPlanner;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, nullptr);
+
+  const pthread_t planner = pthread_self();
+  std::atomic<bool> done(false);
+  std::thread stepper([&]() {
+    std::mt19937 delays(2);
+    while (!done) {
+      pthread_kill(planner, SIGUSR1);
+      while (sem_wait(&s_plannerParked) != 0) {}
+      s_stepperIsr();
+      sem_post(&s_isrDone);
+
+      // Let the planner run for a while, the wake up interrupts it at a random point
+      const timespec delay = { 0, long(delays() % 5000) };
+      nanosleep(&delay, nullptr);
+    }
+  });
+
+  // Note: the planner waits for the stepper at random, so blocks are claimed
+  //       from a full buffer, and as soon as they are published, then for a
+  //       while (e.g. parsing the next command), so it is interrupted at
+  //       random points while planning
+  float x = 0, y = 0;
+  for (const auto& move : s_moves) {
+    x += move.dx;
+    y += move.dy;
+    plan_buffer_line(x, y, 0, 0, move.feedrate);
+
+    const uint8_t queued = random() % BLOCK_BUFFER_SIZE;
+    while (movesplanned() > queued) {
+      periodic_work();
+    }
+    for (volatile unsigned long i = random() % 100000; i; --i) {}
+  }
+  while (blocks_queued()) {
+    periodic_work();
+  }
+  done = true;
+  stepper.join();
+
+  CHECK(s_nextMove == Moves, "ran %lu moves, expected %lu", s_nextMove, Moves);
+  if (!s_checkFailures) {
+    printf("%lu moves handed off in %lu interrupts, %lu claims deferred while the planner was updating\n",
+      Moves, s_isrCalls, s_claimsDeferred);
+  }
+  return testResult();
+}
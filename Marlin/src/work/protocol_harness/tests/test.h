@@ -0,0 +1,26 @@
+#pragma once
+
+// Checks for the native tests (see native_tests.py)
+// A failed check is reported and counted, the test continues. Tests return
+// testResult() from main, so any failure fails the test.
+#include <stdio.h>
+
+static unsigned long s_checkFailures = 0;
+
+#define CHECK(condition, ...) \
+  do { \
+    if (!(condition)) { \
+      ++s_checkFailures; \
+      fprintf(stderr, "%s:%d: check failed: %s, ", __FILE__, __LINE__, #condition); \
+      fprintf(stderr, __VA_ARGS__); \
+      fputc('\n', stderr); \
+    } \
+  } while (0)
+
+inline int testResult() {
+  if (s_checkFailures) {
+    fprintf(stderr, "%lu checks failed\n", s_checkFailures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Thermistor conversion, the lookup table (ThermistorLookupTable.h) against
+// the linear scan of ThermistorTable.h it replaced
+// Checks the lookup stays within the deviation create_thermistor_lookuptable.py
+// reports, and that temperatureToRaw is its inverse, then times a conversion
+// of every raw value.
+#include <math.h>
+
+#include "benchmark.h"
+#include "test.h"
+#include "MarlinConfig.h" // PROGMEM, before the tables
+#include "src/vone/pins/BedTemperaturePin/BedTemperaturePin.h"
+
+static const long AdcMax = 1024; // 10-bit
+
+// The linear scan, as used before the lookup table
+static float s_scanRawToTemperature(long raw) {
+  const auto size = sizeof(temperatureTable)/sizeof(*temperatureTable);
+  for (auto i = 1u; i < size; ++i) {
+    if (PGM_RD_W(temperatureTable[i][0]) > raw) {
+      return (
+        PGM_RD_W(temperatureTable[i-1][1]) +
+          (raw - PGM_RD_W(temperatureTable[i-1][0])) *
+          (float)(PGM_RD_W(temperatureTable[i][1]) - PGM_RD_W(temperatureTable[i-1][1])) /
+          (float)(PGM_RD_W(temperatureTable[i][0]) - PGM_RD_W(temperatureTable[i-1][0]))
+      );
+    }
+  }
+  return PGM_RD_W(temperatureTable[size - 1][1]);
+}
+
+int main() {
+  // Within the deviation in ThermistorLookupTable.h, where the bed is used
+  float maxDeviation = 0;
+  for (long raw = 0; raw < AdcMax; ++raw) {
+    const float expected = s_scanRawToTemperature(raw);
+    if (expected < BED_MINTEMP || expected > BED_MAXTEMP) {
+      continue;
+    }
+    const float deviation = fabsf(BedTemperaturePin::rawToTemperature(raw) - expected);
+    maxDeviation = fmaxf(maxDeviation, deviation);
+    CHECK(deviation <= (expected <= 250 ? 0.5f : 0.75f), "raw %ld is %.2fC, expected %.2fC",
+      raw, BedTemperaturePin::rawToTemperature(raw), expected);
+  }
+
+  // temperatureToRaw is the coldest raw value at least as hot as the target,
+  // to within the truncation of the interpolation
+  // Note: raw values decrease as the temperature increases
+  const int16_t Tolerance = 1; // 1/THERMISTOR_LOOKUP_SCALE C
+  for (float celsius = BED_MINTEMP; celsius <= BED_MAXTEMP; celsius += 0.25f) {
+    const int16_t target = celsius * THERMISTOR_LOOKUP_SCALE;
+    const long raw = BedTemperaturePin::temperatureToRaw(celsius);
+    CHECK(BedTemperaturePin::rawToFixedTemperature(raw) >= target - Tolerance,
+      "%.2fC is raw %ld, which is %.2fC", celsius, raw, BedTemperaturePin::rawToTemperature(raw));
+    CHECK(BedTemperaturePin::rawToFixedTemperature(raw + 1) < target + Tolerance,
+      "%.2fC is raw %ld, but raw %ld is %.2fC", celsius, raw, raw + 1, BedTemperaturePin::rawToTemperature(raw + 1));
+  }
+
+  // Note: a conversion per call, cycling through every raw value
+  printf("thermistor (per conversion):\n");
+  reportNs("linear scan", measureNs(1000000, [](unsigned long i) {
+    keep(s_scanRawToTemperature(i % AdcMax));
+  }), "conversion");
+  reportNs("lookup (rawToTemperature)", measureNs(1000000, [](unsigned long i) {
+    keep(BedTemperaturePin::rawToTemperature(i % AdcMax));
+  }), "conversion");
+  reportNs("lookup (rawToFixedTemperature)", measureNs(1000000, [](unsigned long i) {
+    keep(BedTemperaturePin::rawToFixedTemperature(i % AdcMax));
+  }), "conversion");
+  reportNs("temperatureToRaw", measureNs(1000000, [](unsigned long i) {
+    keep(BedTemperaturePin::temperatureToRaw(BED_MINTEMP + (i % 1200) * 0.25f));
+  }), "conversion");
+
+  if (!s_checkFailures) {
+    printf("lookup within %.2fC of the linear scan\n", maxDeviation);
+  }
+  return testResult();
+}
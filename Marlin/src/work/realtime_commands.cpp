@@ -0,0 +1,171 @@
+#include "../../Marlin.h"
+#include "../../planner.h"
+#include "../../stepper.h"
+#include "../api/movement/movement.h"
+#include "../vone/VOne.h"
+#include "work.h"
+
+#if ENABLED(REALTIME_COMMANDS)
+
+// Realtime commands
+// Single bytes that are acted on as soon as they are received (in the serial
+// receive isr), rather than after the commands queued ahead of them. They are
+// not stored in the receive buffer, so can be sent at any time, even in the
+// middle of a command.
+//   0x81 - Feed hold, decelerate to a stop, keeping the queued moves
+//   0x82 - Resume, after a feed hold
+//   0x83 - Abort, decelerate to a stop, discard the queued moves and reject
+//          further moves until the stepper is resumed (i.e. D5 E1)
+//   0x84 - Status, output the position and state of motion
+//   0x85 - Babystep up, raise z by BABYSTEP_REALTIME_STEPS (like M290, but
+//          without waiting for the commands queued ahead of it)
+//   0x86 - Babystep down, lower z by BABYSTEP_REALTIME_STEPS
+// Note: these bytes never appear in text commands. In binary frames, which can
+//       contain any byte, they are ignored (see binaryCommand.h)
+static const unsigned char FeedHold = 0x81;
+static const unsigned char Resume   = 0x82;
+static const unsigned char Abort    = 0x83;
+static const unsigned char Status   = 0x84;
+static const unsigned char BabystepUp   = 0x85;
+static const unsigned char BabystepDown = 0x86;
+
+// Responses are output by the main loop
+static volatile bool s_holdReceived = false;
+static volatile bool s_resumeReceived = false;
+static volatile bool s_abortReceived = false;
+static volatile bool s_statusRequested = false;
+static volatile bool s_babystepReceived = false;
+static volatile bool s_babystepRejected = false;
+
+// Babysteps are limited in the same way as M290 (see Stepper::babystepZ),
+// the rejection is reported by the main loop
+static bool s_babystep(long steps) {
+  if (vone->stepper.stopped()) {
+    return false;
+  }
+  const long limit = millimetersToSteps(BABYSTEP_MAX_Z_OFFSET, Z_AXIS);
+  if (labs(st_get_babysteps_z() + steps) > limit) {
+    return false;
+  }
+  st_babystep_z(steps);
+  return true;
+}
+
+bool receiveRealtimeCommand(unsigned char ch) {
+#if ENABLED(BINARY_COMMANDS)
+  // Track binary frames, the same way read_commands() does
+  static bool s_inFrame = false;
+  static bool s_frameEmpty = true;
+  if (ch == 0) {
+    if (!s_inFrame) {
+      s_inFrame = true;
+      s_frameEmpty = true;
+    } else if (!s_frameEmpty) {
+      s_inFrame = false;
+    }
+    return false;
+  }
+  if (s_inFrame) {
+    s_frameEmpty = false;
+    return false;
+  }
+#endif
+
+  switch (ch) {
+    case FeedHold:
+      holdFeed();
+      s_holdReceived = true;
+      return true;
+
+    case Resume:
+      resumeFeed();
+      s_resumeReceived = true;
+      return true;
+
+    case Abort:
+      vone->stepper.stop(F("movement aborted by realtime command"), true);
+      s_abortReceived = true;
+      return true;
+
+    case Status:
+      s_statusRequested = true;
+      return true;
+
+    case BabystepUp:
+    case BabystepDown:
+      if (s_babystep(ch == BabystepUp ? BABYSTEP_REALTIME_STEPS : -BABYSTEP_REALTIME_STEPS)) {
+        s_babystepReceived = true;
+      } else {
+        s_babystepRejected = true;
+      }
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+static const __FlashStringHelper* s_motionState() {
+  if (vone->stepper.stopped()) {
+    return F("stopped");
+  } else if (feedHeld()) {
+    return F("held");
+  } else if (blocks_queued()) {
+    return F("moving");
+  } else {
+    return F("idle");
+  }
+}
+
+void reportRealtimeCommands() {
+  if (s_holdReceived) {
+    s_holdReceived = false;
+    log << F("Feed hold") << endl;
+  }
+
+  if (s_resumeReceived) {
+    s_resumeReceived = false;
+    log << F("Resuming feed") << endl;
+  }
+
+  if (s_babystepReceived) {
+    s_babystepReceived = false;
+    log << F("Babystep offset Z:") << vone->stepper.babystepOffsetZ() << endl;
+  }
+
+  if (s_babystepRejected) {
+    s_babystepRejected = false;
+    logError
+      << F("Unable to babystep, ")
+      << (vone->stepper.stopped() ? F("stepper is stopped") : F("total adjustment would exceed the limit"))
+      << F(", offset Z:") << vone->stepper.babystepOffsetZ()
+      << endl;
+  }
+
+  if (s_statusRequested) {
+    s_statusRequested = false;
+    protocol
+      << F("Status: ") << s_motionState()
+      << F(" X:") << st_get_position_mm(X_AXIS)
+      << F(" Y:") << st_get_position_mm(Y_AXIS)
+      << F(" Z:") << st_get_position_mm(Z_AXIS)
+      << F(" E:") << st_get_position_mm(E_AXIS)
+      << F(" queued:") << movesplanned()
+      << endl;
+  }
+}
+
+// Once stopped, bring the planner back in line with the step counts (no
+// steps are lost while decelerating). Like D5 E0, but done in the main loop,
+// since an abort can arrive in the middle of a command.
+void processRealtimeCommands() {
+  if (!s_abortReceived || blocks_queued()) {
+    return;
+  }
+  s_abortReceived = false;
+
+  vone->stepper.resyncWithStepCount(true, true, true, true);
+  logWarning << F("Movement aborted by realtime command") << endl;
+}
+
+#endif
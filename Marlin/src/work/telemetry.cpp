@@ -0,0 +1,136 @@
+#include "../../Marlin.h"
+#include "../../planner.h"
+#include "../../stepper.h"
+#include "../utils/cobs.h"
+#include "../utils/crc16.h"
+#include "../vone/VOne.h"
+#include "work.h"
+
+#if ENABLED(BINARY_TELEMETRY)
+
+#if TX_BUFFER_SIZE == 0
+  #error "BINARY_TELEMETRY requires a transmit buffer (TX_BUFFER_SIZE > 0)"
+#endif
+
+// Binary telemetry
+// A frame of the machine's state, output periodically (see M131). Like
+// compact log records (see serial.cpp), frames are COBS encoded, with a
+// CRC16, and delimited by zeros, so they can be picked out of the text
+// output. Frames are never waited for, if the transmit buffer does not have
+// room for a frame it is skipped (the host can detect skipped frames using
+// the sequence number).
+//
+// Frame layout (little-endian, see decode_telemetry.py)
+//    0  uint8   type (0x80, i.e. not a compact log item)
+//    1  uint8   sequence number
+//    2  uint32  time (ms)
+//    6  int32   x, y, z and e step counts
+//   22  int16   bed temperature (0.1 C)
+//   24  int16   bed target temperature (0.1 C)
+//   26  uint8   flags (see below)
+//   27  uint8   planned moves
+//   28  uint8   current block (index in the planner's buffer)
+//   29  uint16  crc16 of bytes 0-28
+static const uint8_t TelemetryFrame = 0x80;
+static const uint8_t FrameSize = 31;
+
+enum TelemetryFlags : uint8_t {
+  HeaterOn       = 0x01,
+  StepperStopped = 0x02,
+  FeedHeld       = 0x04
+};
+
+static unsigned long s_period = 0;
+static unsigned long s_nextOutputAt = 0;
+static uint8_t s_sequence = 0;
+static unsigned long s_skipped = 0;
+
+static uint8_t* s_writeInt32(uint8_t* ptr, int32_t value) {
+  ptr[0] = value;
+  ptr[1] = value >> 8;
+  ptr[2] = value >> 16;
+  ptr[3] = value >> 24;
+  return ptr + 4;
+}
+
+static uint8_t* s_writeInt16(uint8_t* ptr, int16_t value) {
+  ptr[0] = value;
+  ptr[1] = value >> 8;
+  return ptr + 2;
+}
+
+static uint8_t s_flags() {
+  uint8_t flags = 0;
+  if (vone->heater.heaterOn()) {
+    flags |= HeaterOn;
+  }
+  if (vone->stepper.stopped()) {
+    flags |= StepperStopped;
+  }
+  #if ENABLED(REALTIME_COMMANDS)
+    if (feedHeld()) {
+      flags |= FeedHeld;
+    }
+  #endif
+  return flags;
+}
+
+void setTelemetryPeriod(unsigned long periodMs) {
+  s_period = periodMs;
+  s_nextOutputAt = millis();
+}
+
+unsigned long telemetryPeriod() {
+  return s_period;
+}
+
+unsigned long telemetrySkipped() {
+  return s_skipped;
+}
+
+void output_telemetry() {
+  if (s_period == 0) {
+    return;
+  }
+  const auto now = millis();
+  if (now < s_nextOutputAt) {
+    return;
+  }
+  s_nextOutputAt += s_period;
+
+  // Don't fall behind, e.g. after a long blocking command
+  if (s_nextOutputAt < now) {
+    s_nextOutputAt = now + s_period;
+  }
+
+  // Skip the frame rather than wait for room
+  // Note: every byte is encoded as one byte (there are fewer than 254), plus
+  //       the COBS code byte and 2 delimiters
+  const uint8_t sequence = s_sequence++;
+  if (MYSERIAL.availableForWrite() < FrameSize + 3) {
+    ++s_skipped;
+    return;
+  }
+
+  uint8_t frame[FrameSize];
+  uint8_t* ptr = frame;
+  *ptr++ = TelemetryFrame;
+  *ptr++ = sequence;
+  ptr = s_writeInt32(ptr, now);
+  for (auto axis = 0; axis < NUM_AXIS; ++axis) {
+    ptr = s_writeInt32(ptr, st_get_position(AxisEnum(axis)));
+  }
+  ptr = s_writeInt16(ptr, vone->heater.currentTemperature() * 10);
+  ptr = s_writeInt16(ptr, vone->heater.targetTemperature() * 10);
+  *ptr++ = s_flags();
+  *ptr++ = movesplanned();
+  *ptr++ = block_buffer_tail;
+  const uint16_t crc = crc16(frame, ptr - frame);
+  ptr = s_writeInt16(ptr, crc);
+
+  MYSERIAL.write(uint8_t(0));
+  cobsEncode(frame, ptr - frame, [](uint8_t byte) { MYSERIAL.write(byte); });
+  MYSERIAL.write(uint8_t(0));
+}
+
+#endif
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+
+""" Stream a g-code file to the printer using the windowed protocol.
+
+A reference implementation of the host side of the windowed protocol (see
+process_serial_commands.cpp). Several numbered lines are kept in flight, each
+ok ("ok N<line> B<free slots>") acknowledges a line, and a resend request
+rewinds the stream to the requested line (go-back-N). Errors are tagged with
+the line number of the command that reported them ("error: N<line> ..."),
+since they can follow its ok, and are reported with the command.
+
+Also measures the protocol: reports commands per second, resends and the ack
+latency distribution (from sending a line to receiving its ok), optionally
+with corruption injected into the lines sent, and the printer's own view of
+the session (see D7). Use a window of 1 for a one-line-at-a-time baseline.
+
+The port can be a serial device or a pty, e.g. when testing against the
+native protocol harness (see protocol_harness/). Requires pyserial.
+"""
+
+import argparse
+import random
+import re
+import sys
+import time
+
+import serial
+
+import binary_commands
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('port', help='serial port or pty to connect to')
+parser.add_argument('gcode', help='file of commands to send')
+parser.add_argument('-b', '--baud', type=int, default=115200, help='baud rate (default=115200)')
+parser.add_argument('-l', '--first-line', type=int, default=1, help='the line number the printer expects next (default=1)')
+parser.add_argument('-w', '--window', type=int, default=4, help='maximum lines in flight, at most BUFSIZE (default=4)')
+parser.add_argument('-r', '--rx-bytes', type=int, default=255, help='maximum bytes in flight, at most RX_BUFFER_SIZE - 1 (default=255)')
+parser.add_argument('-t', '--timeout', type=float, default=5.0, help='seconds to wait for an ok before resending (default=5)')
+parser.add_argument('--binary', action='store_true', help='send moves as binary commands (see binary_commands.py)')
+parser.add_argument('--corrupt', type=float, default=0, help='fraction of lines to corrupt, by changing a byte (default=0)')
+parser.add_argument('--drop', type=float, default=0, help='fraction of lines to drop a byte from (default=0)')
+parser.add_argument('--seed', type=int, help='random seed for corruption, for repeatable runs')
+parser.add_argument('--stats', action='store_true', help="output the printer's protocol stats (D7) when done")
+parser.add_argument('-v', '--verbose', action='store_true', help='output everything received from the printer')
+args = parser.parse_args()
+
+
+def crc8(data):
+    """ Dallas/Maxim crc8, see utils/crc8.h """
+    crc = 0
+    for byte in data:
+        for _ in range(8):
+            mix = (crc ^ byte) & 0x01
+            crc >>= 1
+            if mix:
+                crc ^= 0x8C
+            byte >>= 1
+    return crc
+
+
+def frame(line_number, command):
+    """ Add the message validation fields (line number, checksum and length) """
+    if args.binary:
+        data = binary_commands.encode(line_number, command)
+        if data:
+            return data
+
+    msg = 'N%d %s' % (line_number, command)
+    msg += '*%x' % crc8(msg.encode('ascii'))
+    return ('%s,%d\n' % (msg, len(msg))).encode('ascii')
+
+
+def inject_errors(data):
+    """ Corrupt or drop a byte (never the terminator), to exercise error recovery """
+    if args.corrupt and random.random() < args.corrupt:
+        i = random.randrange(len(data) - 1)
+        data = data[:i] + bytes([(data[i] + random.randrange(1, 255)) % 256 or 1]) + data[i + 1:]
+    if args.drop and random.random() < args.drop:
+        i = random.randrange(len(data) - 1)
+        data = data[:i] + data[i + 1:]
+    return data
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))] if values else 0
+
+
+def read_commands(path):
+    commands = []
+    for line in open(path):
+        command = line.split(';', 1)[0].strip()
+        if command:
+            commands.append(command)
+    return commands
+
+
+class Connection:
+    def __init__(self, port, baud):
+        self.port = serial.serial_for_url(port, baudrate=baud, timeout=0.01)
+        self.pending = b''
+
+    def write(self, data):
+        self.port.write(data)
+
+    def readlines(self):
+        self.pending += self.port.read(self.port.in_waiting or 1)
+        *lines, self.pending = self.pending.split(b'\n')
+        for line in lines:
+            line = line.decode('ascii', 'replace').strip()
+            if args.verbose:
+                print('<', line, file=sys.stderr)
+            yield line
+
+
+def parse_ok(line):
+    """ Returns the acknowledged line number, or None for a legacy ok """
+    fields = dict((f[0], int(f[1:])) for f in line.split()[1:] if len(f) > 1 and f[1:].isdigit())
+    return fields.get('N')
+
+
+def parse_resend(line):
+    return int(line.split(':', 1)[1].split(',', 1)[0])
+
+
+ERROR = re.compile(r'error: N(\d+) (.*)')
+
+
+def parse_error(line):
+    """ Returns the line number and message of a tagged error, or None """
+    match = ERROR.match(line)
+    return (int(match.group(1)), match.group(2)) if match else None
+
+
+def send_and_wait(conn, line_number, command):
+    """ Send one command the legacy way, i.e. wait for its ok """
+    conn.write(frame(line_number, command))
+    deadline = time.time() + args.timeout
+    while time.time() < deadline:
+        for line in conn.readlines():
+            if line.startswith('ok'):
+                return
+            if line.startswith('Resend'):
+                sys.exit('Printer requested a resend of "%s": %s' % (command, line))
+    sys.exit('Timed out waiting for "%s"' % command)
+
+
+def stream(conn, commands, first_line):
+    """ Send all commands, keeping a window of lines in flight """
+    last_line = first_line + len(commands) - 1
+    next_line = first_line
+    in_flight = {}  # line number -> bytes sent
+    sent_at = {}    # line number -> time sent
+    latencies = []  # seconds from sending a line to receiving its ok
+    resends = 0
+    errors = 0
+    last_progress = time.time()
+
+    def command(line_number):
+        return commands[line_number - first_line]
+
+    while next_line <= last_line or in_flight:
+        # Fill the window
+        while next_line <= last_line and len(in_flight) < args.window:
+            data = frame(next_line, command(next_line))
+            if in_flight and sum(in_flight.values()) + len(data) > args.rx_bytes:
+                break
+            conn.write(inject_errors(data))
+            in_flight[next_line] = len(data)
+            sent_at[next_line] = time.time()
+            next_line += 1
+
+        for line in conn.readlines():
+            if line.startswith('ok'):
+                acked = parse_ok(line)
+                if acked is None:
+                    sys.exit('Received a legacy ok, is the windowed protocol enabled?')
+                # Note: acks are usually in order, but not always (e.g. the ok for
+                #       a line that is too long is sent immediately)
+                if in_flight.pop(acked, None) is not None:
+                    latencies.append(time.time() - sent_at[acked])
+                last_progress = time.time()
+
+            elif line.startswith('Resend'):
+                # Go back to the requested line, later lines were discarded by the printer
+                requested = parse_resend(line)
+                if requested > next_line:
+                    sys.exit('Printer requested a resend of a line not yet sent: ' + line)
+                for n in [n for n in in_flight if n >= requested]:
+                    del in_flight[n]
+                next_line = requested
+                resends += 1
+                last_progress = time.time()
+
+            elif line.startswith('error'):
+                errors += 1
+                tagged = parse_error(line)
+                if tagged and first_line <= tagged[0] <= last_line:
+                    print('Line %d ("%s") failed: %s' % (tagged[0], command(tagged[0]), tagged[1]), file=sys.stderr)
+                elif not args.verbose:
+                    print(line, file=sys.stderr)
+
+        # Lost ok or lost resend, go back to the oldest unacknowledged line
+        if in_flight and time.time() - last_progress > args.timeout:
+            next_line = min(in_flight)
+            in_flight.clear()
+            resends += 1
+            last_progress = time.time()
+
+    return resends, latencies, errors
+
+
+random.seed(args.seed)
+conn = Connection(args.port, args.baud)
+commands = read_commands(args.gcode)
+
+line_number = args.first_line
+for command in ['M130 W1'] + (['D7 R'] if args.stats else []):
+    send_and_wait(conn, line_number, command)
+    line_number += 1
+
+start = time.time()
+resends, latencies, errors = stream(conn, commands, line_number)
+elapsed = time.time() - start
+line_number += len(commands)
+
+print('Sent %d commands in %.2fs (%.1f commands/s), resends: %d, errors: %d' % (
+    len(commands), elapsed, len(commands) / elapsed if elapsed else 0, resends, errors))
+print('Ack latency (ms): p50:%.1f p90:%.1f p99:%.1f max:%.1f' % tuple(
+    1000 * percentile(latencies, f) for f in (0.5, 0.9, 0.99, 1.0)))
+
+if args.stats:
+    # Echo the printer's stats, i.e. the lines logged with the ok
+    # Note: log lines can arrive after the ok (see TX_PRIORITY_BUFFER_SIZE),
+    #       so keep reading until the printer is quiet
+    args.verbose = True
+    send_and_wait(conn, line_number, 'D7')
+    quiet_at = time.time() + 0.2
+    while time.time() < quiet_at:
+        for line in conn.readlines():
+            quiet_at = time.time() + 0.2
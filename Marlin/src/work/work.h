@@ -19,6 +19,21 @@ void manufacturing_procedures();
 void processSerialCommands();
 void flushSerialCommands();
 void checkForEndstopHits();
+void setWindowedProtocol(bool enable);
+bool windowedProtocol();
+void resetProtocolStats();
+void outputProtocolStats();
+
+// Realtime commands (see realtime_commands.cpp)
+bool receiveRealtimeCommand(unsigned char ch); // from the serial isr, returns true if ch was a realtime command
+void reportRealtimeCommands();
+void processRealtimeCommands();
+
+// Binary telemetry (see telemetry.cpp)
+void setTelemetryPeriod(unsigned long periodMs); // 0 to stop
+unsigned long telemetryPeriod();
+unsigned long telemetrySkipped();
+void output_telemetry();
 
 // Other
 void periodic_output();
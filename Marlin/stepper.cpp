@@ -30,15 +30,18 @@ and Philipp Tiefenbacher. */
 #include "src/vone/VOne.h"
 #include "src/vone/endstops/EndstopMonitor.h"
 #include "src/vone/stepper/calculateStepTiming.h"
+#include "src/vone/stepper/StepperTrace.h"
 
 //===========================================================================
 //=============================private variables ============================
 //===========================================================================
 
 static volatile bool s_stopRequested = false;
+static volatile bool s_decelerationRequested = false;
 
 static long acceleration_time, deceleration_time;
 static unsigned short acc_step_rate; // needed for deccelaration start point
+static unsigned short s_stepRate;    // the step rate currently being executed
 static uint16_t OCR1A_nominal;
 static uint8_t stepPerISR_nominal;
 
@@ -55,6 +58,50 @@ static long counter_x, counter_y, counter_z, counter_e;
 // The number of step events executed in the current block
 static unsigned long step_events_completed = 0;
 
+// Slow blocks
+// Blocks with a nominal rate below SLOW_STEP_RATE run at a constant rate (it is
+// below the jerk speed of every axis, so no acceleration is needed). TIMER1's
+// prescaler is switched from 8 (2MHz) to 64 (250kHz) for these blocks, which
+// supports rates down to 4 steps/s rather than bottoming out at 32 steps/s.
+#define SLOW_STEP_RATE 120
+#define SLOW_TIMER_FREQUENCY (F_CPU / 64)
+#define SLOW_MINIMUM_STEP_RATE 4 // i.e. SLOW_TIMER_FREQUENCY / 65535, rounded up
+static bool s_slowPrescaler = false;
+static uint16_t s_slowTimer;
+
+// Babystepping
+static volatile long s_babystepsPending = 0; // Z steps still to be issued (signed)
+static volatile long s_babystepsApplied = 0; // Z steps issued, since the position was last set
+static unsigned long s_babystepTimer = BABYSTEP_INTERVAL;
+
+// Decelerating stops and feed holds
+// The current block decelerates at its acceleration (see s_startDeceleration).
+// If it ends before reaching rest, the deceleration carries on into the queued
+// blocks, each re-planned to decelerate from the rate the previous block ended
+// at (see s_continueDeceleration). Only once the rate is down to
+// DECELERATION_FINAL_RATE are the blocks discarded (stop) or held, so no steps
+// are lost.
+#define DECELERATION_FINAL_RATE 120 // See calculate_trapezoid_for_block()
+enum class Deceleration : uint8_t { None, ToStop, ToHold };
+static Deceleration s_deceleration = Deceleration::None;
+static unsigned long s_plannedFinalRate; // the block's final rate, before decelerating
+static unsigned long s_carriedRate;      // the rate the previous block ended at, while decelerating
+
+// Feed hold
+// The current block decelerates to a stop, but is kept, along with the queued
+// blocks. On resume, the remainder of the block accelerates from rest (see
+// s_replanFromRest).
+enum class HoldState : uint8_t { NotHeld, Decelerating, Held };
+static volatile HoldState s_holdState = HoldState::NotHeld;
+static volatile bool s_holdRequested = false;
+static volatile bool s_resumeRequested = false;
+static bool s_replanOnResume = false;   // the next block to run must start from rest
+
+// The step event on which the current block ends
+// Note: this is the block's step_event_count, unless the block was cut short by
+//       a decelerating stop
+static unsigned long s_lastStepEvent = 0;
+
 //===========================================================================
 //=============================functions         ============================
 //===========================================================================
@@ -63,20 +110,45 @@ static unsigned long step_events_completed = 0;
 #define DISABLE_STEPPER_DRIVER_INTERRUPT() CBI(TIMSK1, OCIE1A)
 #define STEPPER_ISR_ENABLED()             TEST(TIMSK1, OCIE1A)
 
+static FORCE_INLINE void s_setSlowPrescaler(bool slow) {
+  if (slow == s_slowPrescaler) {
+    return;
+  }
+  s_slowPrescaler = slow;
+  TCCR1B = (TCCR1B & ~(0x07<<CS10)) | ((slow ? 3 : 2)<<CS10);
+
+  // The count so far is in the previous prescaler's tics, start the next
+  // interval from zero rather than reading it in the new prescaler's tics
+  TCNT1 = 0;
+}
+
 static FORCE_INLINE void s_handleNewBlock(
   const volatile block_t& block,
   uint16_t& timer,
   uint8_t& stepsPerISR
 ) {
-  // Pre-compute values for nominal speed
-  calculateStepTiming(block.nominal_rate, OCR1A_nominal, stepPerISR_nominal);
-
-  // Reset acceleration variables
+  // Run slow blocks at a constant rate, using the slow prescaler
+  s_setSlowPrescaler(block.nominal_rate < SLOW_STEP_RATE);
+  if (s_slowPrescaler) {
+    const unsigned long rate = max(block.nominal_rate, SLOW_MINIMUM_STEP_RATE);
+    s_slowTimer = SLOW_TIMER_FREQUENCY / rate;
+    timer = s_slowTimer;
+    stepsPerISR = 1;
+    acc_step_rate = rate;
+    s_stepRate = rate;
+    vone->stepper.maxStepRate.updateIfHigher(rate);
+  } else {
+    // Pre-compute values for nominal speed
+    calculateStepTiming(block.nominal_rate, OCR1A_nominal, stepPerISR_nominal);
+
+    // Reset acceleration variables
+    acc_step_rate = block.initial_rate;
+    calculateStepTiming(acc_step_rate, timer, stepsPerISR);
+    vone->stepper.maxStepRate.updateIfHigher(acc_step_rate);
+    acceleration_time = timer;
+    s_stepRate = acc_step_rate;
+  }
   deceleration_time = 0;
-  acc_step_rate = block.initial_rate;
-  calculateStepTiming(acc_step_rate, timer, stepsPerISR);
-  vone->stepper.maxStepRate.updateIfHigher(acc_step_rate);
-  acceleration_time = timer;
 
   // Reset step counters
   counter_x = -(block.step_event_count >> 1);
@@ -84,6 +156,7 @@ static FORCE_INLINE void s_handleNewBlock(
   counter_z = counter_x;
   counter_e = counter_x;
   step_events_completed = 0;
+  s_lastStepEvent = block.step_event_count;
 
   // Set the direction
   const auto direction_bits = block.direction_bits;
@@ -132,6 +205,34 @@ static FORCE_INLINE void s_doStep(const volatile block_t& block) {
   }
 }
 
+// Issue a babystep, if one is pending and enough time has passed since the last one
+// Note: the z direction pin is restored afterwards, in case a block is moving in z
+static FORCE_INLINE void s_babystep(unsigned long elapsedTime) {
+  if (s_babystepsPending == 0) {
+    s_babystepTimer = BABYSTEP_INTERVAL;
+    return;
+  }
+
+  if (s_babystepTimer < BABYSTEP_INTERVAL) {
+    s_babystepTimer += elapsedTime;
+    return;
+  }
+  s_babystepTimer = 0;
+
+  const signed char dir = s_babystepsPending > 0 ? 1 : -1;
+  WRITE(Z_DIR_PIN, dir == -1 ? INVERT_Z_DIR : !INVERT_Z_DIR);
+  delayMicroseconds(1); // direction setup time
+
+  WRITE(Z_STEP_PIN, !INVERT_Z_STEP_PIN);
+  count_position[Z_AXIS] += dir;
+  s_babystepsPending -= dir;
+  s_babystepsApplied += dir;
+  WRITE(Z_STEP_PIN, INVERT_Z_STEP_PIN);
+
+  delayMicroseconds(1); // direction hold time
+  WRITE(Z_DIR_PIN, zDir == -1 ? INVERT_Z_DIR : !INVERT_Z_DIR);
+}
+
 static FORCE_INLINE bool s_checkEndstops(const volatile block_t& block) {
   bool triggeredInX = false;
   bool triggeredInY = false;
@@ -156,6 +257,14 @@ static FORCE_INLINE void s_calculateStepTiming(
 ) {
   auto& stepper = vone->stepper;
 
+  // --------------------------------------------
+  // Slow blocks run at a constant rate
+  if (s_slowPrescaler) {
+    timer = s_slowTimer;
+    stepsPerIsr = 1;
+    return;
+  }
+
   // --------------------------------------------
   // Calculate new timer value
   if (step_events_completed <= (unsigned long int)block.accelerate_until) {
@@ -173,6 +282,7 @@ static FORCE_INLINE void s_calculateStepTiming(
     stepper.maxStepRate.updateIfHigher(acc_step_rate);
     calculateStepTiming(acc_step_rate, timer, stepsPerIsr);
     acceleration_time += timer;
+    s_stepRate = acc_step_rate;
   } else if (step_events_completed > (unsigned long int)block.decelerate_after) {
     unsigned short step_rate;
     MultiU24X24toH16(step_rate, deceleration_time, block.acceleration_rate);
@@ -192,13 +302,132 @@ static FORCE_INLINE void s_calculateStepTiming(
     stepper.maxStepRate.updateIfHigher(step_rate);
     calculateStepTiming(step_rate, timer, stepsPerIsr);
     deceleration_time += timer;
+    s_stepRate = step_rate;
   } else {
     stepper.maxStepRate.updateIfHigher(block.nominal_rate);
     timer = OCR1A_nominal;
     stepsPerIsr = stepPerISR_nominal;
+    s_stepRate = block.nominal_rate;
   }
 }
 
+// Re-plan the remainder of the block as the shortest deceleration ramp that
+// the block's acceleration allows (i.e. d = (v^2 - vf^2) / 2a), starting from
+// the current step rate. The block ends once the ramp is complete, or at its
+// last step, if the ramp is longer (see s_continueDeceleration).
+// Note: the bresenham counters are left untouched, so every step taken is
+//       counted and the position remains exact
+static FORCE_INLINE void s_startDeceleration(block_t& block) {
+  const unsigned long finalRate = DECELERATION_FINAL_RATE;
+  unsigned long stepsToStop = 0;
+  if (s_stepRate > finalRate && block.acceleration_st > 0) {
+    const unsigned long rate = s_stepRate;
+    stepsToStop = (rate * rate - finalRate * finalRate) / (2 * block.acceleration_st);
+  }
+
+  s_plannedFinalRate = block.final_rate;
+  block.accelerate_until = 0;
+  block.decelerate_after = step_events_completed;
+  block.final_rate = finalRate;
+  acc_step_rate = s_stepRate;
+  deceleration_time = 0;
+
+  s_lastStepEvent = step_events_completed + stepsToStop;
+  NOMORE(s_lastStepEvent, block.step_event_count);
+}
+
+static FORCE_INLINE void s_discardAllBlocks() {
+  while (blocks_queued()) {
+    plan_discard_current_block();
+  }
+}
+
+// The deceleration reached DECELERATION_FINAL_RATE, i.e. rest, so stop or hold
+// Note: a held block is kept (if there is one), the rest of it is re-planned
+//       from rest on resume
+static FORCE_INLINE void s_finishDeceleration(block_t*& current_block) {
+  if (s_deceleration == Deceleration::ToHold) {
+    s_holdState = HoldState::Held;
+    s_replanOnResume = true;
+  } else {
+    s_discardAllBlocks();
+    current_block = nullptr;
+  }
+  s_deceleration = Deceleration::None;
+}
+
+// Continue decelerating in a new block, from the rate the previous block ended
+// at. The rate is scaled by the planned junction (the previous block's final
+// rate and this block's initial rate are the same speed), so the speed is
+// continuous across the junction.
+// Note: slow blocks run below the jerk speed of every axis, i.e. at rest
+static FORCE_INLINE void s_continueDeceleration(block_t*& block, uint16_t& timer, uint8_t& stepsPerISR) {
+  unsigned long rate = 0;
+  if (s_plannedFinalRate > 0) {
+    rate = s_carriedRate * block->initial_rate / s_plannedFinalRate;
+  }
+  NOMORE(rate, block->initial_rate);
+  if (s_slowPrescaler || rate <= DECELERATION_FINAL_RATE) {
+    s_finishDeceleration(block);
+    return;
+  }
+
+  acc_step_rate = rate;
+  calculateStepTiming(acc_step_rate, timer, stepsPerISR);
+  vone->stepper.maxStepRate.updateIfHigher(acc_step_rate);
+  s_stepRate = acc_step_rate;
+  s_startDeceleration(*block);
+}
+
+// Re-plan the remainder of the block to accelerate from rest (i.e. from the
+// rate a decelerating stop ends at), using the same trapezoid as the planner
+// (see calculate_trapezoid_for_block)
+// Note: this is rare, so float math is acceptable, but interrupts should be enabled
+static void s_replanFromRest(block_t& block, uint16_t& timer, uint8_t& stepsPerISR) {
+  const unsigned long initialRate = min(block.initial_rate, (unsigned long)DECELERATION_FINAL_RATE);
+  const float acceleration = block.acceleration_st;
+  const float startRate = initialRate;
+  const float cruiseRate = block.nominal_rate;
+  const float endRate = block.final_rate;
+  const long remainingSteps = block.step_event_count - step_events_completed;
+
+  long accelerateSteps = ceil((cruiseRate * cruiseRate - startRate * startRate) / (2 * acceleration));
+  long decelerateSteps = floor((cruiseRate * cruiseRate - endRate * endRate) / (2 * acceleration));
+  long plateauSteps = remainingSteps - accelerateSteps - decelerateSteps;
+  if (plateauSteps < 0) {
+    accelerateSteps = ceil((2 * acceleration * remainingSteps - startRate * startRate + endRate * endRate) / (4 * acceleration));
+    accelerateSteps = constrain(accelerateSteps, 0, remainingSteps);
+    plateauSteps = 0;
+  }
+
+  block.initial_rate = initialRate;
+  block.accelerate_until = step_events_completed + accelerateSteps;
+  block.decelerate_after = step_events_completed + accelerateSteps + plateauSteps;
+
+  // Restart the acceleration (see s_handleNewBlock)
+  acc_step_rate = initialRate;
+  calculateStepTiming(acc_step_rate, timer, stepsPerISR);
+  acceleration_time = timer;
+  deceleration_time = 0;
+  s_stepRate = acc_step_rate;
+  s_lastStepEvent = block.step_event_count;
+}
+
+#if ENABLED(STEPPER_TRACE)
+  static FORCE_INLINE stepperTrace::Phase s_tracePhase(const block_t* block) {
+    using namespace stepperTrace;
+    if (!block) {
+      return Idle;
+    } else if (step_events_completed <= (unsigned long int)block->accelerate_until) {
+      return Accelerating;
+    } else if (step_events_completed > (unsigned long int)block->decelerate_after) {
+      return Decelerating;
+    } else {
+      return Cruising;
+    }
+  }
+#endif
+
 ISR(TIMER1_COMPA_vect) {
   const auto isr_start = micros();
   auto& stepper = vone->stepper;
@@ -209,15 +438,63 @@ ISR(TIMER1_COMPA_vect) {
   // Check for stop request
   if (s_stopRequested) {
     s_stopRequested = false;
-    while (blocks_queued()) {
-      plan_discard_current_block();
-    }
+    s_decelerationRequested = false;
+    s_deceleration = Deceleration::None;
+    s_babystepsPending = 0;
+    s_holdState = HoldState::NotHeld;
+    s_replanOnResume = false;
+    s_discardAllBlocks();
     current_block = nullptr;
+
+  // --------------------------------------------
+  // Check for decelerating stop request
+  // Notes:
+  //   1) if held, we are at rest and can stop immediately
+  //   2) a block starts at its junction speed, which can be close to its
+  //      nominal speed, so even a block that has not taken a step decelerates
+  //   3) if the next block is not claimed yet (i.e. the planner is updating
+  //      it), the request is handled once it is
+  } else if (s_decelerationRequested) {
+    if (s_holdState == HoldState::Held) {
+      s_decelerationRequested = false;
+      s_discardAllBlocks();
+      current_block = nullptr;
+      s_holdState = HoldState::NotHeld;
+      s_replanOnResume = false;
+    } else if (current_block) {
+      s_decelerationRequested = false;
+      if (s_deceleration == Deceleration::None) {
+        s_startDeceleration(*current_block);
+      }
+      s_deceleration = Deceleration::ToStop;
+      s_holdState = HoldState::NotHeld;
+    } else if (!blocks_queued()) {
+      s_decelerationRequested = false;
+    }
+
+  // --------------------------------------------
+  // Check for feed hold request
+  // Note: if there is nothing to hold (i.e. no moves queued), or we are
+  //       already holding or stopping, it is ignored
+  } else if (s_holdRequested) {
+    if (
+      s_holdState != HoldState::NotHeld ||
+      s_deceleration != Deceleration::None ||
+      !blocks_queued()
+    ) {
+      s_holdRequested = false;
+    } else if (current_block) {
+      s_holdRequested = false;
+      s_startDeceleration(*current_block);
+      s_deceleration = Deceleration::ToHold;
+      s_holdState = HoldState::Decelerating;
+    }
   }
 
   // --------------------------------------------
   // Move, if we already have a block
-  if (current_block) {
+  uint8_t stepsTaken = 0;
+  if (current_block && s_holdState != HoldState::Held) {
     // Take multiple steps per interrupt (For high speed moves)
     for (int8_t i = 0; i < step_loops; i++) {
       s_doStep(*current_block);
@@ -226,13 +503,19 @@ ISR(TIMER1_COMPA_vect) {
         stepper.maxStepsComplete.updateIfHigher(micros() - isr_start);
       }
 
+      ++stepsTaken;
       step_events_completed += 1;
-      if (step_events_completed >= current_block->step_event_count) {
+      if (step_events_completed >= s_lastStepEvent) {
         break;
       }
     }
   }
 
+  // --------------------------------------------
+  // Adjust z, if requested
+  // Note: OCR1A still holds the time since the last isr call
+  s_babystep(s_slowPrescaler ? (unsigned long)OCR1A << 3 : OCR1A);
+
   // --------------------------------------------
   // Allow (some) other interrupts, so we don't miss serial characters
   const bool temp_isr_was_enabled = TEMPERATURE_ISR_ENABLED();
@@ -243,8 +526,9 @@ ISR(TIMER1_COMPA_vect) {
 
   // --------------------------------------------
   // Continue processing the current block
+  // Note: no steps are taken while held
   auto triggered = false;
-  if (current_block) {
+  if (current_block && stepsTaken) {
     // Detect end-stop hits
     // Note: only check in the direction(s) we are moving
     triggered = s_checkEndstops(*current_block);
@@ -256,28 +540,76 @@ ISR(TIMER1_COMPA_vect) {
       //       If it was not then any queued moves no longer make sense
       quickStop();
 
-    // If block finished normally
-    } else if (step_events_completed >= current_block->step_event_count) {
+    // If decelerated to rest, part way through the block
+    // Note: if held, the block is kept and the remainder is re-planned on resume
+    } else if (
+      s_deceleration != Deceleration::None &&
+      step_events_completed >= s_lastStepEvent &&
+      s_lastStepEvent < current_block->step_event_count
+    ) {
+      current_block->final_rate = s_plannedFinalRate;
+      s_finishDeceleration(current_block);
+
+    // If block finished
+    // Note: if still decelerating, the deceleration carries on into the next block
+    } else if (step_events_completed >= s_lastStepEvent) {
       current_block = nullptr;
       plan_discard_current_block();
+
+      if (s_deceleration != Deceleration::None) {
+        if (s_stepRate <= DECELERATION_FINAL_RATE || !blocks_queued()) {
+          s_finishDeceleration(current_block);
+        } else {
+          s_carriedRate = s_stepRate;
+        }
+      }
     }
   }
 
   // --------------------------------------------
   // Determine timing for next isr call
   uint16_t timer = 2000; // 1kHz
-  if (current_block) {
-    s_calculateStepTiming(*current_block, timer, step_loops);
+  if (s_resumeRequested && s_holdState != HoldState::Decelerating) {
+    s_resumeRequested = false;
+    if (s_holdState == HoldState::Held) {
+      s_holdState = HoldState::NotHeld;
+    }
+  }
+
+  if (s_holdState == HoldState::Held) {
+    // Wait for resume
+  } else if (current_block) {
+    // Note: slow blocks run at a constant rate, so do not need re-planning
+    if (s_replanOnResume && !s_slowPrescaler) {
+      s_replanFromRest(*current_block, timer, step_loops);
+    } else {
+      s_calculateStepTiming(*current_block, timer, step_loops);
+    }
+    s_replanOnResume = false;
   } else {
     // Get next block
-    current_block = plan_get_current_block();
+    current_block = plan_claim_current_block();
     if (current_block) {
-      current_block->busy = true;
       s_handleNewBlock(*current_block, timer, step_loops);
+      if (s_deceleration != Deceleration::None) {
+        s_continueDeceleration(current_block, timer, step_loops);
+      } else {
+        if (s_replanOnResume && !s_slowPrescaler) {
+          s_replanFromRest(*current_block, timer, step_loops);
+        }
+        s_replanOnResume = false;
+      }
+    } else {
+      s_setSlowPrescaler(false);
+      if (blocks_queued()) {
+        timer = 100; // The planner is updating the block, try again in 50us
+      }
     }
   }
-  stepper.maxStepTiming.updateIfLower(timer);
+  // Note: reported in 2MHz tics, regardless of the prescaler
+  stepper.maxStepTiming.updateIfLower(s_slowPrescaler ? (unsigned long)timer << 3 : timer);
   OCR1A = timer;
+  STEPPER_TRACE_RECORD(timer, s_slowPrescaler, stepsTaken, current_block ? current_block - block_buffer : 0, s_tracePhase(current_block));
 
   // --------------------------------------------
   // Restore interrupt settings
@@ -317,6 +649,7 @@ void st_set_position(const long& x, const long& y, const long& z, const long& e)
   count_position[Y_AXIS] = y;
   count_position[Z_AXIS] = z;
   count_position[E_AXIS] = e;
+  s_babystepsApplied = 0;
 }
 
 void st_set_e_position(const long& e) {
@@ -337,3 +670,32 @@ void quickStop() {
   ScopedInterruptDisable sid;
   s_stopRequested = true;
 }
+
+void st_babystep_z(long steps) {
+  ScopedInterruptDisable sid;
+  s_babystepsPending += steps;
+}
+
+long st_get_babysteps_z() {
+  ScopedInterruptDisable sid;
+  return s_babystepsApplied + s_babystepsPending;
+}
+
+void decelerateToStop() {
+  ScopedInterruptDisable sid;
+  s_decelerationRequested = true;
+}
+
+void holdFeed() {
+  ScopedInterruptDisable sid;
+  s_holdRequested = true;
+}
+
+void resumeFeed() {
+  ScopedInterruptDisable sid;
+  s_resumeRequested = true;
+}
+
+bool feedHeld() {
+  return s_holdState != HoldState::NotHeld;
+}
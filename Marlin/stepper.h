@@ -36,4 +36,24 @@ void st_set_e_position(const long &e);
 long st_get_position(AxisEnum axis);
 float st_get_position_mm(AxisEnum axis);
 
+// Babystepping -- adjust z, independently of the queued moves
+// Note: the step count includes babysteps
+void st_babystep_z(long steps);
+long st_get_babysteps_z(); // total adjustment (applied and pending), since the position was last set
+
+// Stop immediately and discard all queued moves
+// Note: steps may be lost if the stepper is moving quickly
 void quickStop();
+
+// Decelerate to a stop, as quickly as the current move's acceleration allows
+// (continuing into the queued moves, if the current move ends first), then
+// discard all queued moves. No steps are lost, so the planner can be resync'd
+// with the step counts, rather than re-homing.
+void decelerateToStop();
+
+// Feed hold -- decelerate to a stop (as decelerateToStop does, including
+// through queued moves), but keep the queued moves, they continue
+// (accelerating from rest) on resume
+void holdFeed();
+void resumeFeed();
+bool feedHeld(); // decelerating to, or stopped in, a hold
@@ -1,24 +1,67 @@
+#include "temperature_profile.h"
 #include "Configuration.h"
 #include "serial.h"
 #include "src/vone/VOne.h"
 #include "src/vone/bed/heater/Heater.h"
 #include "src/utils/time.h"
+#include "src/utils/ScopedInterruptDisable.h"
+
+// Note: the profile is run by the timer interrupt (see manage_heating_profile),
+//       so the main loop accesses it with interrupts disabled, and the timer
+//       records events for the main loop to report (interrupt output is
+//       prefixed, which the host would not recognize as protocol)
+#define PROFILE_TICK_MS (100)
+#define PROFILE_EVENTS (4)
+
+enum class ProfileEvent : uint8_t {
+  Started,
+  Reached,
+  TimedOut,
+  NoChange,
+  Complete
+};
+
+static struct {
+  ProfileEvent type;
+  uint8_t rate;           // 1/PROFILE_RATE_SCALE C/s, when Started
+  uint16_t hold;          // seconds
+  float target;
+  float temperature;      // current, or at the start of the ramp when Reached
+  unsigned long time;     // when it happened
+  unsigned long elapsed;  // ramp duration when Reached
+} s_events[PROFILE_EVENTS];
+static volatile uint8_t s_eventHead = 0;
+static volatile uint8_t s_eventTail = 0;
+static volatile uint8_t s_eventsDropped = 0;
+
+// A step of the profile, packed (temperatures are validated to be 0-240C)
+struct Segment {
+  uint8_t temperature;  // degrees C
+  uint8_t rate;         // 1/PROFILE_RATE_SCALE C/s, 0 to ramp as fast as the heater allows
+  uint16_t duration;    // hold, in seconds
+};
 
-#define PROFILE_SIZE (10)
 static struct {
   unsigned long holdUntil = 0;
   unsigned long startTime = 0;
+  unsigned long heatedFor = 0; // ms of full output since the ramp started
   float changeTemperature = 0;
   bool ramping = false;
   bool holding = false;
-  int head = 0; // Indicates start of queue.
-  int tail = 0; // Indicates end of queue
-  int temperature[PROFILE_SIZE]; // Temperature in degrees C
-  unsigned long duration[PROFILE_SIZE]; // Duration in seconds
+  uint8_t head = 0;  // The current step
+  uint8_t count = 0; // Steps remaining, including the current step
+  Segment segments[PROFILE_SIZE];
 } profile;
 
+static Segment& s_segment(uint8_t index) {
+  return profile.segments[(profile.head + index) % PROFILE_SIZE];
+}
+
+static float s_rate(const Segment& segment) {
+  return segment.rate / float(PROFILE_RATE_SCALE);
+}
 
-static int s_validate_input(const int temperature, const int duration){
+static int s_validate_input(const int temperature, const int duration, const float rate){
 
   // Ensure both parameters were received.
   if (temperature == 0 || duration == 0){
@@ -43,8 +86,21 @@ static int s_validate_input(const int temperature, const int duration){
     return -1;
   }
 
+  // Note: rounds to the stored resolution, rates that round to 0 are rejected
+  //       rather than treated as 'as fast as possible'
+  const auto scaledRate = long(rate * PROFILE_RATE_SCALE + 0.5f);
+  if (rate < 0 || (rate > 0 && scaledRate == 0) || scaledRate > 255){
+    logError
+      << F("Invalid ramp rate received: ") << rate
+      << F(", must be 0 or between ") << 1.0f / PROFILE_RATE_SCALE
+      << F(" and ") << 255.0f / PROFILE_RATE_SCALE << F("C/s")
+      << endl;
+    return -1;
+  }
+
   // Check if we still have space.
-  if (profile.tail >= PROFILE_SIZE){
+  // Note: only the main loop adds to the profile (the timer only removes steps)
+  if (profile.count >= PROFILE_SIZE){
     logError
       << F("Cannot append to heating profile. Queue full")
       << endl;
@@ -54,41 +110,77 @@ static int s_validate_input(const int temperature, const int duration){
   return 0;
 }
 
-void profile_reset() {
-  memset(profile.temperature, 0, sizeof(profile.temperature));
-  memset(profile.duration, 0, sizeof(profile.duration));
-  profile.tail = 0;
+static void s_record(
+  ProfileEvent type, float target, float temperature,
+  unsigned long elapsed = 0, uint16_t hold = 0, uint8_t rate = 0
+) {
+  const uint8_t next = (s_eventTail + 1) % PROFILE_EVENTS;
+  if (next == s_eventHead) {
+    ++s_eventsDropped;
+    return;
+  }
+  auto& event = s_events[s_eventTail];
+  event.type = type;
+  event.rate = rate;
+  event.hold = hold;
+  event.target = target;
+  event.temperature = temperature;
+  event.time = millis();
+  event.elapsed = elapsed;
+  s_eventTail = next;
+}
+
+static void s_clear() {
+  ScopedInterruptDisable sid;
+  memset(profile.segments, 0, sizeof(profile.segments));
+  profile.count = 0;
   profile.head = 0;
   profile.ramping = false;
   profile.holding = false; //<-- not really required, but reads nicer.
   profile.holdUntil = 0;
   profile.startTime = 0;
+  profile.heatedFor = 0;
   profile.changeTemperature = 0;
+}
+
+void profile_reset() {
+  s_clear();
   vone->heater.setTargetTemperature(0); //DEFER: refactor to eliminate dependency on vone object
 }
 
-int profile_add(const int temperature, const int duration) {
+// Reset from the timer interrupt, without logging
+static void s_resetFromInterrupt() {
+  s_clear();
+  vone->heater.changeTargetTemperature(0);
+}
+
+int profile_add(const int temperature, const int duration, const float rate) {
   // Confirm sensible values were received.
-  if (s_validate_input(temperature, duration)){
+  if (s_validate_input(temperature, duration, rate)){
     return -1;
   }
 
-  // Add to temperature and duration to buffer.
-  profile.temperature[profile.tail] = temperature;
-  profile.duration[profile.tail] = duration;
-  profile.tail ++;
+  // Add the step to the end of the queue
+  // Note: publish the entry (i.e. count) after it is written
+  ScopedInterruptDisable sid;
+  auto& segment = s_segment(profile.count);
+  segment.temperature = temperature;
+  segment.rate = rate * PROFILE_RATE_SCALE + 0.5f;
+  segment.duration = duration;
+  profile.count ++;
 
   return 0;
 }
 
 bool profile_empty() {
-  return profile.tail == 0;
-}
-bool profile_complete() {
-  return profile.head >= profile.tail;
+  return profile.count == 0;
 }
 
-static float s_computeRampTime(float startTemp, float endTemp) {
+static float s_computeRampTime(float startTemp, float endTemp, float rate) {
+  if (rate > 0) {
+    return abs(endTemp - startTemp) / rate;
+  }
+
   //Heating and cooling rates are not symmetrical (VERY ROUGH ESTIMATE).
   const auto heatingRate = 0.5; // seconds per degrees
   const auto coolingRate = 10.0; // seconds per degrees
@@ -96,42 +188,145 @@ static float s_computeRampTime(float startTemp, float endTemp) {
   return delta > 0 ? delta * heatingRate : -delta * coolingRate;
 }
 
-float profile_sum_durations(int index){
-  // Calculates duration given the current index.
-  // Starts with index duration and takes account transition ramp (if available)
+static float profile_sum_durations(uint8_t head, uint8_t count){
+  // Calculates duration of the remaining steps, starting at head.
+  // Starts with head's duration and takes account transition ramp (if available)
   float sum = 0;
-  for (auto i = index; i < profile.tail; ++i) {
+  const Segment* previous = nullptr;
+  for (uint8_t i = 0; i < count; ++i) {
+    const auto& segment = profile.segments[(head + i) % PROFILE_SIZE];
+
     // add ramp time from previous temp to this one
-    if (i > index) {
-      sum += s_computeRampTime(profile.temperature[i-1], profile.temperature[i]);
+    if (previous) {
+      sum += s_computeRampTime(previous->temperature, segment.temperature, s_rate(segment));
     }
 
     // Add duration at this temperature
-    sum += profile.duration[i];
+    sum += segment.duration;
+    previous = &segment;
   }
   return sum;
 }
 
 // Calulate how much time is remaining in seconds
 float profile_remaining_time(){
-  if (profile_empty() || profile_complete()){
+  // Snapshot the state the timer changes
+  // Note: the steps only change if the profile is reset (only the main
+  //       loop adds steps), at worst we report a stale time once
+  uint8_t head, count;
+  bool ramping;
+  unsigned long holdUntil;
+  {
+    ScopedInterruptDisable sid;
+    head = profile.head;
+    count = profile.count;
+    ramping = profile.ramping;
+    holdUntil = profile.holdUntil;
+  }
+  if (count == 0){
     return 0;
   }
 
   // Iterate through remaining profile and get durations and ramp rates.
-  float sum = profile_sum_durations(profile.head);
+  float sum = profile_sum_durations(head, count);
 
-  if (profile.ramping) {
+  const auto& current = profile.segments[head];
+  if (ramping) {
     // Add our current ramping time.
-    sum += s_computeRampTime(vone->heater.currentTemperature(), vone->heater.targetTemperature());
+    sum += s_computeRampTime(vone->heater.currentTemperature(), vone->heater.targetTemperature(), s_rate(current));
   } else {
     // Substract our elapsed time. (duration - time remaining)
-    sum -= profile.duration[profile.head] - (profile.holdUntil - millis()) / 1000ul;
+    const auto now = millis();
+    sum -= current.duration - (holdUntil > now ? (holdUntil - now) / 1000ul : 0);
   }
 
   return sum;
 }
 
+void report_heating_profile() {
+  for (;;) {
+    // Copy the event, so we don't log with interrupts disabled
+    uint8_t dropped;
+    auto event = s_events[0];
+    {
+      ScopedInterruptDisable sid;
+      dropped = s_eventsDropped;
+      s_eventsDropped = 0;
+      if (s_eventHead == s_eventTail && !dropped) {
+        return;
+      }
+      if (s_eventHead != s_eventTail) {
+        event = s_events[s_eventHead];
+      }
+    }
+
+    if (dropped) {
+      logWarning << F("Heating profile events were not reported: ") << dropped << endl;
+      continue;
+    }
+
+    const auto ago = millis() - event.time;
+    switch (event.type) {
+      case ProfileEvent::Started:
+        if (event.rate) {
+          log
+            << F("New target Temperature: ") << event.target
+            << F(", ramping at ") << event.rate / float(PROFILE_RATE_SCALE) << F("C/s")
+            << endl;
+        } else {
+          log << F("New target Temperature: ") << event.target << endl;
+        }
+        break;
+
+      case ProfileEvent::Reached: {
+        const auto averageTempchange = abs(event.target - event.temperature) > 2 ? (event.target - event.temperature) / event.elapsed : 0;
+        log
+            << F("Reached ")
+            << event.target
+            << F("C from ")
+            << event.temperature
+            << F(" in ")
+            << event.elapsed / 1000.0
+            << F("s; average ramp: ")
+            << averageTempchange * 1000.0
+            << F("C/s. Holding for ")
+            << event.hold
+            << F("s")
+            << endl;
+        break;
+      }
+
+      case ProfileEvent::TimedOut:
+        logError
+          << F("Failed to reach target temperature within timeout period. ")
+          << F("Current: ") << event.temperature << F("C")
+          << F("Target: ") << event.target << F("C")
+          << endl;
+        break;
+
+      case ProfileEvent::NoChange:
+        logError
+          << F("Temperature change not detected. ")
+          << F("Current: ") << event.temperature << F("C")
+          << F("Target: ") << event.target << F("C")
+          << endl;
+        break;
+
+      case ProfileEvent::Complete:
+        protocol << F("profileComplete") << endl;
+        break;
+    }
+
+    // Note if the main loop was blocked, the event's timing is still accurate
+    if (ago >= 1000) {
+      log << F("Heating profile event reported ") << ago << F("ms late") << endl;
+    }
+
+    ScopedInterruptDisable sid;
+    s_eventHead = (s_eventHead + 1) % PROFILE_EVENTS;
+  }
+}
+
 void manage_heating_profile() {
 
   // Early return if our profile is empty
@@ -139,22 +334,38 @@ void manage_heating_profile() {
     return;
   }
 
+  // Run periodically
+  static unsigned long nextTickAt = 0;
   const unsigned long now = millis();
+  if (now < nextTickAt) {
+    return;
+  }
+  nextTickAt = now + PROFILE_TICK_MS;
+
   const auto target = vone->heater.targetTemperature();
   const auto current = vone->heater.currentTemperature();
+  const auto& segment = profile.segments[profile.head];
+  const auto rate = s_rate(segment);
 
   // If we are ramping, check temperature and timeout
   if (profile.ramping) {
+    #if ENABLED(PIDTEMPBED)
+      const unsigned long output = vone->heater.output();
+    #else
+      const unsigned long output = vone->heater.heaterOn() ? 255 : 0;
+    #endif
+    profile.heatedFor += output * PROFILE_TICK_MS / 255;
 
     // Check if our safety timeout has been exceeeded. Looks only at time.
-    const auto safetyTimeout = minutes(profile.temperature[profile.head] > current ? 8 : 25);
+    // Note: a ramp is given the time it should take, on top of the usual timeout
+    auto safetyTimeout = minutes(segment.temperature > current ? 8 : 25);
+    if (rate > 0) {
+      safetyTimeout += seconds(abs(segment.temperature - profile.changeTemperature) / rate);
+    }
     if (now >= (profile.startTime + safetyTimeout)) {
-      logError
-        << F("Failed to reach target temperature within timeout period. ")
-        << F("Current: ") << current << F("C")
-        << F("Target: ") << target << F("C")
-        << endl;
-      profile_reset();
+      s_record(ProfileEvent::TimedOut, target, current);
+      s_resetFromInterrupt();
+      return;
     }
 
     // Check if the temperature has not moved at all during heating. Could indicate a loose/fallen thermistor
@@ -172,33 +383,27 @@ void manage_heating_profile() {
     //
     // DEFER: it's possible that significant cooling would result in more thermal inertia and a
     //        higher changeTemperature. 20s may not be enough to overcome that.
-    if (now >= (profile.startTime + seconds(20)) && (target > current) && abs(current - profile.changeTemperature) < 2) {
-      logError
-        << F("Temperature change not detected. ")
-        << F("Current: ") << current << F("C")
-        << F("Target: ") << target << F("C")
-        << endl;
-      profile_reset();
+    //
+    // Note: the 20s is of heating at full output. Measuring the heater's on time, rather than
+    //       the time since the step began, means a slow ramp (which only asks for a little
+    //       power) is not mistaken for a loose thermistor, while a loose thermistor (which
+    //       drives the output up) is still detected after the same amount of heating
+    if (profile.heatedFor >= seconds(20) && (target > current) && abs(current - profile.changeTemperature) < 2) {
+      s_record(ProfileEvent::NoChange, target, current);
+      s_resetFromInterrupt();
+      return;
     }
 
     // Check if we are within 2 degrees
-    if (abs(target - current) < 2) {
-      const auto rampDuration = now - profile.startTime;
-      const auto averageTempchange = abs(target - profile.changeTemperature) > 2 ? (target - profile.changeTemperature)  / rampDuration : 0;
-      log
-          << F("Reached ")
-          << target
-          << F("C from ")
-          << profile.changeTemperature
-          << F(" in ")
-          << rampDuration / 1000.0
-          << F("s; average ramp: ")
-          << averageTempchange * 1000.0
-          << F("C/s. Holding for ")
-          << profile.duration[profile.head]
-          << F("s")
-          << endl;
-      profile.holdUntil = now + seconds(profile.duration[profile.head]); // Hold this temp for X seconds
+    // Note: a ramp is not over until the setpoint reaches the target, otherwise
+    //       the hold would start while the ramp still had 2 degrees to go
+    const bool rampDone = rate == 0 || vone->heater.setpoint() == target;
+    if (rampDone && abs(target - current) < 2) {
+      s_record(
+        ProfileEvent::Reached, target, profile.changeTemperature,
+        now - profile.startTime, segment.duration
+      );
+      profile.holdUntil = now + seconds(segment.duration); // Hold this temp for X seconds
       profile.ramping = false;
       profile.holding = true;
     }
@@ -207,21 +412,26 @@ void manage_heating_profile() {
   } else if (profile.holding) {
 
     if (now >= profile.holdUntil) {
+      // Free the step
       profile.holding = false;
-      profile.head ++;
+      profile.head = (profile.head + 1) % PROFILE_SIZE;
+      profile.count --;
 
-      if(profile_complete()){
-        protocol << F("profileComplete") << endl;
-        profile_reset();
+      if(profile_empty()){
+        s_record(ProfileEvent::Complete, 0, current);
+        s_resetFromInterrupt();
       }
     }
   } else {
     // If not ramping or holding, set temperature and ramping timeout.
     // Different timeout if we are heating or cooling
-    const auto newTarget = profile.temperature[profile.head];
+    // Note: the heater moves its setpoint along the ramp (see Heater::advanceSetpoint)
+    const float newTarget = segment.temperature;
     profile.startTime = now;
+    profile.heatedFor = 0;
     profile.changeTemperature = current; // Take snapshot of current temperature.
     profile.ramping = true;
-    vone->heater.setTargetTemperature(newTarget);
+    vone->heater.changeTargetTemperature(newTarget, rate);
+    s_record(ProfileEvent::Started, newTarget, current, 0, 0, segment.rate);
   }
 }
@@ -1,8 +1,25 @@
 #pragma once
 
+// Steps (i.e. segments) in the heating profile, each takes 4 bytes
+// Note: completed steps are freed, so the host can keep adding steps while
+//       the profile runs
+#define PROFILE_SIZE (32)
+
+// Ramp rates are stored in 1/PROFILE_RATE_SCALE C/s, from 0.01 to 2.55C/s
+#define PROFILE_RATE_SCALE (100)
+
 bool profile_empty();
 float profile_remaining_time();
-int profile_add(const int temperature, const int duration);
+
+// Ramps to temperature at rate (C/s, or 0 to heat/cool as fast as the
+// heater allows) then holds it for duration (seconds)
+int profile_add(const int temperature, const int duration, const float rate = 0);
 void profile_reset();
 
+// Runs the profile, called from the timer interrupt so steps change and
+// holds end on time while commands block the main loop
+// (see VOne::frequentInterruptibleWork)
 void manage_heating_profile();
+
+// Reports what the profile did (e.g. profileComplete), from the main loop
+void report_heating_profile();